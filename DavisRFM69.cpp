@@ -22,38 +22,45 @@
 
 #include "RFM69registers.h"
 #include "DavisRFM69.h"
-#include "DavisRFM69_frequencies.h"
-
-volatile byte  DavisRFM69::DATA[DAVIS_PACKET_LEN];
-volatile byte DavisRFM69::_mode = RF69_MODE_INIT;       // current transceiver state
-volatile byte DavisRFM69::CHANNEL = 0;
-volatile byte DavisRFM69::band = 0;
-volatile int DavisRFM69::RSSI = 0;   // RSSI measured immediately after payload reception
-volatile int16_t DavisRFM69::FEI = 0;
-
-volatile uint32_t DavisRFM69::packets = 0;
-volatile uint32_t DavisRFM69::lostPackets = 0;
-volatile uint32_t DavisRFM69::numResyncs = 0;
-volatile uint32_t DavisRFM69::lostStations = 0;
-volatile byte DavisRFM69::stationsFound = 0;
-volatile byte DavisRFM69::curStation = 0;
-volatile byte DavisRFM69::numStations = NUMSTATIONS;
+#ifdef DAVISRFM69_DMA_FIFO
+#include "DavisRFM69_dma.h"
+#endif
+
+DavisRFM69Base *DavisRFM69Base::radios[DAVISRFM69_MAX_RADIOS];
+volatile bool DavisRFM69Base::dmaBusy = false;
+DavisRFM69Base *DavisRFM69Base::dmaOwner;
+DavisRFM69Base *volatile DavisRFM69Base::dmaWaiting;
+byte DavisRFM69Base::dmaTx[DAVIS_PACKET_LEN + 1] = { REG_FIFO & 0x7f };
+byte DavisRFM69Base::dmaRx[DAVIS_PACKET_LEN + 1];
+byte DavisRFM69Base::dmaStatus[REG_IRQFLAGS2 - REG_FEIMSB + 1];
+DavisRFM69Base *DavisRFM69Base::timerOwner;
 //volatile uint32_t DavisRFM69::lastDiscStep;
 volatile uint32_t rfm69_mode_timer = 0;
-volatile byte  DavisRFM69::packetIn, DavisRFM69::packetOut, DavisRFM69::qLen;
-
-int freeMemory();
-
 
-volatile enum sm_mode DavisRFM69::mode = SM_IDLE;
-//PacketFifo DavisRFM69::fifo;
-Station *DavisRFM69::stations;
-DavisRFM69* DavisRFM69::selfPointer;
+#define OPMODE_BASE (RF_OPMODE_SEQUENCER_ON | RF_OPMODE_LISTEN_OFF)
+
+static inline uint16_t crc16Step(uint16_t crc, byte b);
+
+DavisRFM69Base::DavisRFM69Base(byte slaveSelectPin, byte interruptPin, byte interruptNum) {
+	memset((void *) spiStats, 0, sizeof(spiStats));
+	memset((void *) isrStats, 0, sizeof(isrStats));
+	crcErrors = 0;
+	_mode = RF69_MODE_STANDBY;
+	CHANNEL = 0;
+	freqCorr = 0;
+	RXTIME = 0;
+	spiOp = SPI_OP_OTHER;
+	_slaveSelectPin = slaveSelectPin;
+	_interruptPin = interruptPin;
+	_interruptNum = interruptNum;
+	}
 
-void DavisRFM69::initialize(byte freqBand) {
+	// Bring up the radio in the Davis configuration, in standby, and route its DIO0
+	// interrupt (and the tune-in timer, if no other radio has it) here
+void DavisRFM69Base::begin() {
 	const byte CONFIG[][2] =
 		{
-		/* 0x01 */ { REG_OPMODE, RF_OPMODE_SEQUENCER_ON | RF_OPMODE_LISTEN_OFF | RF_OPMODE_STANDBY },
+		/* 0x01 */ { REG_OPMODE, OPMODE_BASE | RF_OPMODE_STANDBY },
 		/* 0x02 */ { REG_DATAMODUL, RF_DATAMODUL_DATAMODE_PACKET | RF_DATAMODUL_MODULATIONTYPE_FSK | RF_DATAMODUL_MODULATIONSHAPING_10 }, // Davis uses Gaussian shaping with BT=0.5
 		/* 0x03 */ { REG_BITRATEMSB, RF_BITRATEMSB_19200}, // Davis uses a datarate of 19.2 KBPS
 		/* 0x04 */ { REG_BITRATELSB, RF_BITRATELSB_19200},
@@ -93,30 +100,28 @@ void DavisRFM69::initialize(byte freqBand) {
 
 	setMode(RF69_MODE_STANDBY);
 	while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // Wait for ModeReady
-	attachInterrupt(_interruptNum, DavisRFM69::isr0, RISING);
-
-	selfPointer = this;
-	userInterrupt = NULL;
-	mode = SM_IDLE;
-	band = freqBand;
-	setChannel(0);
-	for (byte i = 0; i < numStations; i++) {
-		stations[i].channel = 0;
-		stations[i].lastRx = 0;
-		stations[i].interval = 0;
-		stations[i].lostPackets = 0;
-		stations[i].lastRx = 0;
-		stations[i].lastSeen = 0;
-		stations[i].packets = 0;
-		stations[i].syncBegan = 0;
+#ifdef DAVISRFM69_DMA_FIFO
+	spiDmaBegin();
+#endif
+#ifdef DAVISRFM69_TIMER_TUNE
+	if (timerOwner == NULL || timerOwner == this) {
+		timerOwner = this;
+		tuneTimerBegin(tuneTimerFired);
 		}
+#endif
+
+	// a radio initialized again keeps its place
+	byte n = 0;
+	while (n < DAVISRFM69_MAX_RADIOS - 1 && radios[n] != NULL && radios[n] != this) n++;
+	radios[n] = this;
+	attachInterrupt(_interruptNum, n == 0 ? isr0 : isr1, RISING);
 	}
 
 	/**
 	 * compute a 32bit time difference assuming the first argument
 	 * happend after the second. (ie accounting for wrap around).
 	 */
-uint32_t DavisRFM69::difftime(uint32_t after, uint32_t before) {
+uint32_t DavisRFM69Base::difftime(uint32_t after, uint32_t before) {
 	if (after >= before || !(after < 0x8fffffff  && before >0x8fffffff) ) {
 		if (after< before) return 0;
 		return after - before;
@@ -125,336 +130,188 @@ uint32_t DavisRFM69::difftime(uint32_t after, uint32_t before) {
 	return (0xffffffff - before) + after + 1;
 	}
 
-	/**
-	 * Called by the main arduino loop, used when not using a timer (handleTimerInt)
-	 * this will check for lost packets and tune the radio to the proper channel
-	 * hopefully at the proper time. Added by AMM.
-	 */
-void DavisRFM69::loop() {
-	uint8_t i;
-
-	// first see if we have tuned into receive a station previously and failed to actually receive a packet
-	if (mode == SM_RECEIVING) {
-		// There's a bit of a race here as if the packet Interrupt triggers between the above if()
-		// and the below if() it may update curStation to be the next station
-		// however the timing recvBegan will still be the previous loop so this will believe
-		// the packet was lost(until the timing updates later in this function)
-		// so we re-check mode one more time and if the receive packet interrupt cleared it
-		// then we hopefully won't flag a wrong packet as missed
-		// provided the compiler doesn't re-order the checks in the if statement
-
-	  // packet was lost
-		if (difftime(micros(), stations[curStation].recvBegan) > (1 + stations[curStation].lostPackets)*(LATE_PACKET_THRESH + TUNEIN_USEC)
-		&& mode == SM_RECEIVING ) {
-#ifdef DAVISRFM69_DEBUG
-			Serial.print(micros());
-			Serial.print(": missed packet from station ");
-			Serial.print(stations[curStation].id);
-			Serial.print(" channel ");
-			Serial.println(stations[curStation].channel);
-#endif
-			lostPackets++;
-			stations[curStation].lostPackets++;
-				stations[curStation].lastRx += stations[curStation].interval;
-			    stations[curStation].channel = nextChannel(stations[curStation].channel);
-			
-
-			// lost a station
-			if (stations[curStation].lostPackets > RESYNC_THRESHOLD) {
-#ifdef DAVISRFM69_DEBUG
-				Serial.print(micros());
-				Serial.print(": station ");
-				Serial.print(stations[curStation].id);
-				Serial.println(" is lost.");
-#endif
-				stations[curStation].lostPackets = 0;
-				stations[curStation].interval = 0;
-
-				lostStations++;
-				stationsFound--;
-				}
-
-			curStation = -1;
-			mode = SM_IDLE;
-			setMode(RF69_MODE_STANDBY);
-		}
-		else {
-	   // waiting to receive and it hasn't timed out yet.
-	   // do nothing.
-			return;
-			}
-		}
+	// Davis' official tx interval in us for a station id
+uint32_t DavisRFM69Base::nominalInterval(byte id) {
+	return (41 + (id & 7)) * 1000000UL / 16;
+	}
 
-		// next check for any station that's about to transmit
-		// if found, tune in
-	for (i = 0; i < numStations; i++) {
-	  // interval is filled in once we discover a station
-		if (stations[i].interval > 0) {
-#ifdef DAVISRFM69_DEBUG_VERBOSE
-				Serial.print(micros());
-				Serial.print(" ");
-				Serial.print(stations[i].lastRx);
-				Serial.print(" ");
-				Serial.println(difftime(stations[i].lastRx + stations[i].interval,micros()));
-				Serial.print("id ");
-				Serial.print(stations[i].id);
-				Serial.print(" channel ");
-				Serial.println(stations[i].channel);
+	// Where the ISR captures the next packet: the next free rawFifo entry, or a scratch
+	// buffer when loop() has fallen behind (or packets are handled in the ISR anyway)
+RawPacket *DavisRFM69Base::rawSlot() {
+#ifndef DAVISRFM69_RX_IN_ISR
+	RawPacket *rp = rawFifo.slot();
+	if (rp != NULL) return rp;
 #endif
+	return &rawScratch;
+	}
 
-			if (difftime(stations[i].lastRx + stations[i].interval,micros()) < ((1 + stations[i].lostPackets)*TUNEIN_USEC)) {
-#ifdef DAVISRFM69_DEBUG
-				Serial.print(micros());
-				Serial.print(" ");
-				Serial.print(stations[i].lastRx);
-				Serial.print(" ");
-				Serial.println(difftime(stations[i].lastRx + stations[i].interval,micros()));
-				Serial.print(": tune to station ");
-				Serial.print(stations[i].id);
-				Serial.print(" channel ");
-				Serial.println(stations[i].channel);
-#endif
-				stations[i].recvBegan = micros();
-				setChannel(stations[i].channel);
+	// Which of the two CRCs computed while draining the FIFO matches the one received
+static inline byte crcResult(const byte *packet, uint16_t dataCrc, uint16_t rptCrc) {
+	uint16_t rxCrc = word(packet[6], packet[7]);
+	if (rxCrc == 0) return RAW_CRC_BAD;
+	if (dataCrc == rxCrc) return RAW_CRC_OK;
+	if (rptCrc == rxCrc) return RAW_CRC_REPEATER;
+	return RAW_CRC_BAD;
+	}
 
-				// we are now set to receive from this station.
-				mode = SM_RECEIVING;
-				curStation = i;
-				return;
-				}
-			}
+void DavisRFM69Base::interruptHandler() {
+	RXTIME = micros();
+#ifdef DAVISRFM69_DMA_FIFO
+	// DIO0 is PayloadReady while in RX. Start clocking the FIFO out and get out of the
+	// way; dmaComplete() picks it up. Chip select is held through the transfer.
+	// If the other radio's transfer has the bus, this one goes next.
+	if (_mode != RF69_MODE_RX) return;
+	if (dmaBusy) {
+		if (dmaOwner != this) dmaWaiting = this;
+		return;
 		}
+	startDma();
+#else
+	byte op = spiOp;
+	spiOp = SPI_OP_RX;
+	spiStats[SPI_OP_RX].calls++;
+
+	// FEIMSB (0x21) through IRQFLAGS2 (0x28) in one transaction. Read up front when it
+	// is most likely the carrier is still up, for the RSSI.
+	byte status[REG_IRQFLAGS2 - REG_FEIMSB + 1];
+	readBurst(REG_FEIMSB, status, sizeof(status));
+	if (_mode == RF69_MODE_RX && (status[REG_IRQFLAGS2 - REG_FEIMSB] & RF_IRQFLAGS2_PAYLOADREADY)) {
+		RawPacket *rp = rawSlot();
+		rp->time = RXTIME;
+		rp->channel = CHANNEL;
+		rp->rssi = -((-status[REG_RSSIVALUE - REG_FEIMSB]) >> 1);
+		rp->fei = word(status[REG_FEIMSB - REG_FEIMSB], status[REG_FEILSB - REG_FEIMSB]);
+		rp->freqCorr = freqCorr;
+		setMode(RF69_MODE_STANDBY);
 
-		// if no transmitter is about to transmit, check for any
-		// station that we are not synchonized with, if there are
-		// any stations not synchronized, turn on the receiver and
-		// hope we get lucky.
-	bool all_sync = true;
-	for (i = 0; i < numStations; i++) {
-	  // unknown stations will have interval of zero, the radio interrupt will
-	  // fill this in if we receive a packet from the given station.
-		if (stations[i].interval == 0) {
-			mode = SM_SEARCHING;
-			all_sync = false;
-			if (stations[i].syncBegan == 0) {
-				// we have never tried to sync to this station
-#ifdef DAVISRFM69_DEBUG
-				Serial.print(micros());
-				Serial.print(": begin sync to station ");
-				Serial.print(stations[i].id);
-				Serial.print(" channel ");
-				Serial.println(stations[i].channel);
-#endif
-				stations[i].syncBegan = micros();
-				stations[i].progress = 0;
-				setChannel(stations[i].channel);
-				}
-			else if (difftime(micros(), stations[i].syncBegan) > DISCOVERY_STEP) {
-			   // we tried and failed to sync, try the next channel
-
-				stations[i].channel = nextChannel(stations[i].channel);
-#ifdef DAVISRFM69_DEBUG
-				Serial.print(micros());
-				Serial.print(": sync fail, begin sync to station ");
-				Serial.print(stations[i].id);
-				Serial.print(" channel ");
-				Serial.println(stations[i].channel);
-#endif
-				stations[i].syncBegan = micros();
-				stations[i].progress = 0;
-				setChannel(stations[i].channel);
-				}
-			else {
-				if (CHANNEL != stations[i].channel) setChannel(stations[i].channel);
-			 // we're waiting to hear from this station, don't tune away!
-			 setMode(RF69_MODE_RX);
-
-#ifdef DAVISRFM69_DEBUG
-				byte p = difftime(micros(), stations[i].syncBegan) / (DISCOVERY_STEP / 100);
-
-				if (stations[i].progress != p) {
-					Serial.print(micros());
-					Serial.print(": listen progress ");
-					Serial.print(p);
-					Serial.println("\%");
-					stations[i].progress = p;
-					Serial.println(freeMemory());									// Added by JF
-					}
-#endif
-				break;
-				}
+		// Reverse each byte and run both CRCs as it comes off the bus, so the packet
+		// is checked as soon as the last byte lands
+		select();   // Select RFM69 module, disabling interrupts
+		SPI.transfer(REG_FIFO & 0x7f);
+		spiStats[spiOp].bytes += 1 + DAVIS_PACKET_LEN;
+		uint16_t crc = 0, dataCrc = 0;
+		for (byte i = 0; i < DAVIS_PACKET_LEN; i++) {
+			byte b = reverseBits(SPI.transfer(0));
+			rp->packet[i] = b;
+			if (i == 6) dataCrc = crc;
+			if (i < 6 || i > 7) crc = crc16Step(crc, b);
 			}
+		unselect();  // Unselect RFM69 module, enabling interrupts
+		rp->crc = crcResult(rp->packet, dataCrc, crc);
+		rxCaptured(rp);
 		}
-
-	if (all_sync) {
-		mode = SM_SYNCHRONIZED;
-
-		// if we got here, no stations are about to TX and all stations are in sync,
-		// we can disable our radio to save power.
-		if (_mode != RF69_MODE_SLEEP) {
-#ifdef DAVISRFM69_DEBUG
-			Serial.print(micros());
-			Serial.println(": Nothing to do, going to sleep");
+	spiOp = op;
 #endif
-			setMode(RF69_MODE_SLEEP);
-			}
-		}
 	}
 
-	// Handle received packets, called from RFM69 ISR
-void DavisRFM69::handleRadioInt() {
-	uint32_t lastRx = micros();
-	uint16_t rxCrc = word(DATA[6], DATA[7]);  // received CRC
-	uint16_t calcCrc = DavisRFM69::crc16_ccitt(DATA, 6);  // calculated CRC
-
-	bool repeaterCrcTried = false;
-
-	// repeater packets checksum bytes (0..5) and (8..9), so try this at mismatch
-	if (calcCrc != rxCrc) {
-		calcCrc = DavisRFM69::crc16_ccitt(DATA + 8, 2, calcCrc);
-		repeaterCrcTried = true;
-		}
-
-	// packet passed crc?
-	if (calcCrc == rxCrc && rxCrc != 0) {
-
-	  // station id is byte 0:0-2
-		byte id = DATA[0] & 7;
-		int stIx = findStation(id);
-
-		// if we have no station cofigured for this id (at all; can still be be !active), ignore the packet
-		// OR packet passed the repeater crc check, but no repeater is set for the station
-		// OR packet passed the normal crc check, and repeater is set for the station
-		if (stIx < 0
-			|| (repeaterCrcTried && stations[stIx].repeaterId == 0)
-			|| (!repeaterCrcTried && stations[stIx].repeaterId != 0)) {
-			setChannel(CHANNEL);
-			return;
-			}
-
-		if (stationsFound < numStations && stations[stIx].interval == 0) {
-			stations[stIx].interval = ((41 + id) * 1000000 / 16) ;
-			//-(1000000* ((10+2+4)*8/19200)) ; 
-			// Davis' official tx interval in us minus packet length
-			// We don't get signaled till the end of the packet, hopping is from
-			// start to start (4 preamble, 2 sync, 10 data at 19200 symbol/second(bits))
-
-			stationsFound++;
-#ifdef DAVISRFM69_DEBUG
-			Serial.print("found station ");
-			Serial.print(stIx);
-			Serial.print(" interval ");
-			Serial.println(stations[stIx].interval);
+#ifdef DAVISRFM69_DMA_FIFO
+	// Clock the FIFO out of this radio by DMA, holding its chip select through it
+void DavisRFM69Base::startDma() {
+	byte op = spiOp;
+	spiOp = SPI_OP_RX;
+	// FEIMSB through IRQFLAGS2 first, as interruptHandler() does without DMA: once the
+	// FIFO has been read out the receiver restarts, and RSSIVALUE is the noise floor
+	readBurst(REG_FEIMSB, dmaStatus, sizeof(dmaStatus));
+	spiOp = op;
+	if (!(dmaStatus[REG_IRQFLAGS2 - REG_FEIMSB] & RF_IRQFLAGS2_PAYLOADREADY)) return;
+	dmaBusy = true;
+	dmaOwner = this;
+	spiStats[SPI_OP_RX].calls++;
+	spiStats[SPI_OP_RX].transactions++;
+	spiStats[SPI_OP_RX].bytes += sizeof(dmaTx);
+	digitalWrite(_slaveSelectPin, LOW);
+	spiDmaTransfer(dmaTx, dmaRx, sizeof(dmaTx), dmaDone);
+	}
 #endif
-			if (lostStations > 0) lostStations--;
-			}
-
-		packets++;
-		if (stations[stIx].active) {
-			stations[stIx].packets++;
-			if (qLen < FIFO_SIZE) {
-				memcpy(&packetFifo[packetIn].packet, (byte*) DATA, DAVIS_PACKET_LEN);
-				packetFifo[packetIn].channel = CHANNEL;
-				packetFifo[packetIn].rssi = -RSSI;
-				packetFifo[packetIn].fei = FEI;
-				packetFifo[packetIn].delta = stations[curStation].lastSeen > 0 ? lastRx - stations[curStation].lastSeen : 0;
-				if (++packetIn == FIFO_SIZE) packetIn = 0;
-				qLen++;
-				}
-			}
 
-#ifdef DAVISRFM69_DEBUG
-		stations[stIx].earlyAmt = difftime(lastRx, stations[stIx].recvBegan);
-		Serial.print("early amt = ");
-		Serial.println(stations[stIx].earlyAmt);
+	// DMA complete interrupt for the FIFO transfer started by interruptHandler()
+void DavisRFM69Base::dmaDone() {
+	DavisRFM69Base *radio = dmaOwner;
+#ifdef DAVISRFM69_ISR_STATS
+	uint32_t start = micros();
+	radio->dmaComplete();
+	radio->isrTimed(ISR_DMA, start);
+#else
+	radio->dmaComplete();
+#endif
+#ifdef DAVISRFM69_DMA_FIFO
+	// a packet the other radio got while the bus was taken
+	radio = dmaWaiting;
+	dmaWaiting = NULL;
+	if (radio != NULL && radio->_mode == RF69_MODE_RX) radio->startDma();
 #endif
-		stations[stIx].channel = nextChannel(CHANNEL);
-		stations[stIx].lostPackets = 0;
-		stations[stIx].lastRx = lastRx;
-		stations[stIx].lastSeen = lastRx;
-
-	// no longer waiting to RX (if we were at all anwyay)
-		mode = SM_IDLE;
-		// standby the radio
-		setMode(RF69_MODE_STANDBY);
-		}
-	else {
-   // bad CRC, go back to RX on this channel
-		setChannel(CHANNEL); // this always has to be done somewhere right after reception, even for ignored/bogus packets
-		}
 	}
 
-	// Calculate the next hop of the specified channel
-byte DavisRFM69::nextChannel(byte channel) {
-	return ++channel % bandTabLengths[band];
-	}
+void DavisRFM69Base::dmaComplete() {
+	byte op = spiOp;
+	spiOp = SPI_OP_RX;
+	digitalWrite(_slaveSelectPin, HIGH);
+	dmaBusy = false;
 
-	// Find the station index in stations[] for station expected to tx the earliest and update curStation
-void DavisRFM69::nextStation() {
-	uint32_t earliest = 0xffffffff;
-	uint32_t now = micros();
-	for (int i = 0; i < numStations; i++) {
-		uint32_t current = stations[i].lastRx + stations[i].interval - now;
-		if (stations[i].interval > 0 && current < earliest) {
-			earliest = current;
-			curStation = i;
-			}
-		}
-	}
+	setMode(RF69_MODE_STANDBY);
 
-	// Find station index in stations[] for a station ID (-1 if doesn't exist)
-int DavisRFM69::findStation(byte id) {
-	for (byte i = 0; i < numStations; i++) {
-		if (stations[i].id == id) return i;
-		}
-	return -1;
+	// FEI and RSSI as startDma() read them, before the FIFO
+	RawPacket *rp = rawSlot();
+	rp->time = RXTIME;
+	rp->channel = CHANNEL;
+	rp->rssi = -((-dmaStatus[REG_RSSIVALUE - REG_FEIMSB]) >> 1);
+	rp->fei = word(dmaStatus[REG_FEIMSB - REG_FEIMSB], dmaStatus[REG_FEILSB - REG_FEIMSB]);
+	rp->freqCorr = freqCorr;
+	drainFifo(dmaRx + 1, rp);
+	rxCaptured(rp);
+	spiOp = op;
 	}
 
-void DavisRFM69::interruptHandler() {
-	RSSI = (-readReg(REG_RSSIVALUE)) >> 1;  // Read up front when it is most likely the carrier is still up
-	if (_mode == RF69_MODE_RX && (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)) {
-		FEI = word(readReg(REG_FEIMSB), readReg(REG_FEILSB));
-		setMode(RF69_MODE_STANDBY);
-
-		select();   // Select RFM69 module, disabling interrupts
-		SPI.transfer(REG_FIFO & 0x7f);
-		for (byte i = 0; i < DAVIS_PACKET_LEN; i++)
-			DATA[i] = reverseBits(SPI.transfer(0));
-		handleRadioInt();
-		unselect();  // Unselect RFM69 module, enabling interrupts
+	// Same as the FIFO read in interruptHandler(), for bytes the DMA already fetched
+void DavisRFM69Base::drainFifo(const byte *fifo, RawPacket *rp) {
+	uint16_t crc = 0, dataCrc = 0;
+	for (byte i = 0; i < DAVIS_PACKET_LEN; i++) {
+		byte b = reverseBits(fifo[i]);
+		rp->packet[i] = b;
+		if (i == 6) dataCrc = crc;
+		if (i < 6 || i > 7) crc = crc16Step(crc, b);
 		}
+	rp->crc = crcResult(rp->packet, dataCrc, crc);
 	}
 
-void DavisRFM69::setChannel(byte channel) {
-
-#ifdef DAVISRFM69_DEBUG
-	Serial.print("CH->>");
-	Serial.println(channel);
-#endif
 
-	CHANNEL = channel;
-	if (CHANNEL > bandTabLengths[band] - 1) CHANNEL = 0;
-	writeReg(REG_FRFMSB, pgm_read_byte(&bandTab[band][CHANNEL][0]));
-	writeReg(REG_FRFMID, pgm_read_byte(&bandTab[band][CHANNEL][1]));
-	writeReg(REG_FRFLSB, pgm_read_byte(&bandTab[band][CHANNEL][2]));
-
-	if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)
-		writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-	setMode(RF69_MODE_RX);
-	}
+	// Every byte value with its bits reversed. The Cortex-M0+ has no RBIT instruction, so a
+	// lookup beats the shift/mask sequence below by a wide margin.
+static const byte reverseTab[256] PROGMEM = {
+	0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+	0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+	0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+	0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+	0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+	0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+	0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+	0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+	0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+	0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+	0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+	0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+	0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+	0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+	0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+	0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
+	};
 
 	// The data bytes come over the air from the ISS least significant bit first. Fix them as we go. From
 	// http://www.ocf.berkeley.edu/~wwu/cgi-bin/yabb/YaBB.cgi?board=riddles_cs;action=display;num=1103355188
-byte DavisRFM69::reverseBits(byte b) {
+byte DavisRFM69Base::reverseBits(byte b) {
+#ifdef DAVISRFM69_REVERSE_SHIFT
 	b = ((b & 0b11110000) >> 4) | ((b & 0b00001111) << 4);
 	b = ((b & 0b11001100) >> 2) | ((b & 0b00110011) << 2);
 	b = ((b & 0b10101010) >> 1) | ((b & 0b01010101) << 1);
 
 	return(b);
+#else
+	return pgm_read_byte(&reverseTab[b]);
+#endif
 	}
 
 	// Davis CRC calculation from http://www.menie.org/georges/embedded/
-uint16_t DavisRFM69::crc16_ccitt(volatile byte *buf, byte len, uint16_t crc) {
+uint16_t DavisRFM69Base::crc16_ccitt_bitwise(volatile byte *buf, byte len, uint16_t crc) {
 	while (len--) {
 		crc ^= *(char *) buf++ << 8;
 		for (int i = 0; i < 8; ++i) {
@@ -467,64 +324,209 @@ uint16_t DavisRFM69::crc16_ccitt(volatile byte *buf, byte len, uint16_t crc) {
 	return crc;
 	}
 
-void DavisRFM69::setMode(byte newMode) {
-	if (newMode == _mode) return;
+	// CRC16-CCITT (poly 0x1021) of every nibble value, shifted through four bits
+static const uint16_t crc16Tab16[16] PROGMEM = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	};
+
+uint16_t DavisRFM69Base::crc16_ccitt_tab16(volatile byte *buf, byte len, uint16_t crc) {
+	while (len--) {
+		byte b = *buf++;
+		crc = (crc << 4) ^ pgm_read_word(&crc16Tab16[(crc >> 12) ^ (b >> 4)]);
+		crc = (crc << 4) ^ pgm_read_word(&crc16Tab16[(crc >> 12) ^ (b & 0x0f)]);
+		}
+	return crc;
+	}
+
+	// CRC16-CCITT (poly 0x1021) of every byte value
+static const uint16_t crc16Tab256[256] PROGMEM = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+	};
+
+uint16_t DavisRFM69Base::crc16_ccitt_tab256(volatile byte *buf, byte len, uint16_t crc) {
+	while (len--) crc = (crc << 8) ^ pgm_read_word(&crc16Tab256[(crc >> 8) ^ *buf++]);
+	return crc;
+	}
 
-#ifdef DAVISRFM69_DEBUG
-	Serial.print(_mode);
-	Serial.print(" -> ");
-	Serial.println(newMode);
+	// One byte of the CRC, for updating it while the FIFO drains
+static inline uint16_t crc16Step(uint16_t crc, byte b) {
+#if DAVISRFM69_CRC_TABLE == 16
+	crc = (crc << 4) ^ pgm_read_word(&crc16Tab16[(crc >> 12) ^ (b >> 4)]);
+	return (crc << 4) ^ pgm_read_word(&crc16Tab16[(crc >> 12) ^ (b & 0x0f)]);
+#elif DAVISRFM69_CRC_TABLE == 0
+	return DavisRFM69Base::crc16_ccitt_bitwise(&b, 1, crc);
+#else
+	return (crc << 8) ^ pgm_read_word(&crc16Tab256[(crc >> 8) ^ b]);
 #endif
+	}
+
+uint16_t DavisRFM69Base::crc16_ccitt(volatile byte *buf, byte len, uint16_t crc) {
+#if defined(DAVISRFM69_CRC_DMAC) && defined(__SAMD21__)
+	// The DMAC CRC engine in I/O mode: seed the checksum, feed bytes, read it back.
+	// It needs one cycle per byte, less than a store to CRCDATAIN takes.
+	DMAC->CTRL.bit.CRCENABLE = 0;
+	DMAC->CRCCTRL.reg = DMAC_CRCCTRL_CRCBEATSIZE_BYTE | DMAC_CRCCTRL_CRCPOLY_CRC16 | DMAC_CRCCTRL_CRCSRC_IO;
+	DMAC->CRCCHKSUM.reg = crc;
+	DMAC->CTRL.bit.CRCENABLE = 1;
+	while (len--) DMAC->CRCDATAIN.reg = *buf++;
+	crc = DMAC->CRCCHKSUM.reg;
+	DMAC->CRCSTATUS.reg = DMAC_CRCSTATUS_CRCBUSY;
+	DMAC->CTRL.bit.CRCENABLE = 0;
+	return crc;
+#elif DAVISRFM69_CRC_TABLE == 256
+	return crc16_ccitt_tab256(buf, len, crc);
+#elif DAVISRFM69_CRC_TABLE == 16
+	return crc16_ccitt_tab16(buf, len, crc);
+#else
+	return crc16_ccitt_bitwise(buf, len, crc);
+#endif
+	}
+
+void DavisRFM69Base::setMode(byte newMode) {
+	if (newMode == _mode) return;
 
+	TRACE(TR_MODE, _mode, newMode, 0);
+
+	// The other OPMODE bits are only ever set by initialize() (sequencer on, listen off),
+	// so there is no need to read the register back before writing it
 	switch (newMode) {
 			case RF69_MODE_TX:
-				writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_TRANSMITTER);
+				writeReg(REG_OPMODE, OPMODE_BASE | RF_OPMODE_TRANSMITTER);
 				break;
 			case RF69_MODE_RX:
-				writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_RECEIVER);
+				writeReg(REG_OPMODE, OPMODE_BASE | RF_OPMODE_RECEIVER);
 				break;
 			case RF69_MODE_STANDBY:
-				writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);
+				writeReg(REG_OPMODE, OPMODE_BASE | RF_OPMODE_STANDBY);
 				break;
 			case RF69_MODE_SLEEP:
-				writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);		// Changed from RF_OPMODE_SLEEP to RF_OPMODE_STANDBY
-																							// Caused missed packets   JF
+				writeReg(REG_OPMODE, OPMODE_BASE | RF_OPMODE_STANDBY);		// Changed from RF_OPMODE_SLEEP to RF_OPMODE_STANDBY
+																			// Caused missed packets   JF
 				break;
 			default: return;
 		}
 	_mode = newMode;
 	}
 
-void DavisRFM69::isr0() { selfPointer->interruptHandler(); }
+	// DIO0 of the radios in radios[], in the order they were initialized
+static_assert(DAVISRFM69_MAX_RADIOS == 2, "one isrN() per radio");
+void DavisRFM69Base::isr0() { isrDispatch(0); }
+void DavisRFM69Base::isr1() { isrDispatch(1); }
+
+void DavisRFM69Base::isrDispatch(byte n) {
+	DavisRFM69Base *radio = radios[n];
+#ifdef DAVISRFM69_ISR_STATS
+	uint32_t start = micros();
+	radio->interruptHandler();
+	radio->isrTimed(ISR_DIO0, start);
+#else
+	radio->interruptHandler();
+#endif
+	}
+
+#ifdef DAVISRFM69_TIMER_TUNE
+	// Timer compare interrupt for the wakeup on top of the timer owner's wakeHeap
+void DavisRFM69Base::tuneTimerFired() { timerOwner->timerTune(); }
+#endif
 
-byte DavisRFM69::readReg(byte addr) {
+	// Add one interrupt handler run to its duration histogram
+void DavisRFM69Base::isrTimed(byte which, uint32_t start) {
+	uint32_t us = micros() - start;
+	volatile IsrStats &st = isrStats[which];
+	st.count++;
+	if (us > st.maxUs) st.maxUs = us;
+	byte b = 0;
+	while (b < ISR_HIST_BUCKETS - 1 && us >= (2UL << b)) b++;
+	st.hist[b]++;
+	}
+
+byte DavisRFM69Base::readReg(byte addr) {
 	select();
 	SPI.transfer(addr & 0x7F);
 	byte regval = SPI.transfer(0);
 	unselect();
+	spiStats[spiOp].bytes += 2;
 	return regval;
 	}
 
-void DavisRFM69::writeReg(byte addr, byte value) {
+void DavisRFM69Base::writeReg(byte addr, byte value) {
 	select();
 	SPI.transfer(addr | 0x80);
 	SPI.transfer(value);
 	unselect();
+	spiStats[spiOp].bytes += 2;
+	}
+
+	// Read len consecutive registers starting at addr in one transaction, using the
+	// RFM69's address auto-increment (which doesn't apply to REG_FIFO)
+void DavisRFM69Base::readBurst(byte addr, byte *buf, byte len) {
+	select();
+	SPI.transfer(addr & 0x7F);
+	for (byte i = 0; i < len; i++) buf[i] = SPI.transfer(0);
+	unselect();
+	spiStats[spiOp].bytes += 1 + len;
+	}
+
+void DavisRFM69Base::writeBurst(byte addr, const byte *buf, byte len) {
+	select();
+	SPI.transfer(addr | 0x80);
+	for (byte i = 0; i < len; i++) SPI.transfer(buf[i]);
+	unselect();
+	spiStats[spiOp].bytes += 1 + len;
 	}
 
 	/// Select the transceiver
-void DavisRFM69::select() {
+void DavisRFM69Base::select() {
 	noInterrupts();
+	// wait out a DMA FIFO transfer, with interrupts on so its completion can run
+	while (dmaBusy) {
+		interrupts();
+		delayMicroseconds(1);
+		noInterrupts();
+		}
+	spiStats[spiOp].transactions++;
 	digitalWrite(_slaveSelectPin, LOW);
 	}
 
 	/// Unselect the transceiver chip
-void DavisRFM69::unselect() {
+void DavisRFM69Base::unselect() {
 	digitalWrite(_slaveSelectPin, HIGH);
 	interrupts();
 	}
 
-void DavisRFM69::setBandwidth(byte bw) {
+void DavisRFM69Base::setBandwidth(byte bw) {
 	switch (bw) {
 			case RF69_DAVIS_BW_NARROW:
 				writeReg(REG_RXBW, RF_RXBW_DCCFREQ_010 | RF_RXBW_MANT_20 | RF_RXBW_EXP_4); // Use 25 kHz BW (BitRate < 2 * RxBw)
@@ -20,6 +20,9 @@
 #ifndef DAVISRFM69_h
 #define DAVISRFM69_h
 
+#include <Arduino.h>
+#include "DavisRFM69_queue.h"
+
 // Davis VP2 standalone station types
 #define STYPE_ISS         0x0 // ISS
 #define STYPE_TEMP_ONLY   0x1 // Temperature Only Station
@@ -42,8 +45,12 @@
 #define SPI_CS          8 // SS is the SPI slave select pin, for instance D10 on atmega328
 #define RF69_IRQ_PIN    3
 #define RF69_IRQ_NUM    3
+#define SPI_CS_2       10 // a second RFM69, for DavisRFM69Diversity
+#define RF69_IRQ_PIN_2  6
+#define RF69_IRQ_NUM_2  6
 // This is the default, our caller can override.
 #define NUMSTATIONS			  1
+#define MAX_STATIONS		  8 // Davis station IDs are 0..7
 #define DAVIS_PACKET_LEN     10 // ISS has fixed packet lengths of eight bytes including CRC and two bytes trailing repeater info
 
 #define RF69_MODE_SLEEP       0 // XTAL OFF
@@ -62,9 +69,84 @@
 								// this includes possible radio turnaround tx->rx or sleep->rx transitions
 								// 10 ms is reliable, should be able to get this faster but
 								// the loop is polled, so slow loop calls will cause missed packets
+								// (unless DAVISRFM69_TIMER_TUNE is defined)
+
+// Both of the above are only the starting point for each station: the window shrinks to what
+// its packet timing and our tune-in delay need, unless DAVISRFM69_FIXED_WINDOW is defined
+//#define DAVISRFM69_FIXED_WINDOW
+#define PACKET_AIRTIME_USEC	  6667L	// 4 preamble, 2 sync, 10 data bytes at 19200 bps
+#define WINDOW_GUARD_USEC	  1000L	// margin for radio settling and timing noise
+#define WINDOW_WARMUP		  4		// packets before the window is adapted
+#define MISS_WIDEN_USEC		   100L	// window growth per packet missed in a row, besides the timing spread
+
+// Refine each station's interval from its packet timing, to follow the drift between its
+// clock and ours, unless DAVISRFM69_FIXED_INTERVAL is defined
+//#define DAVISRFM69_FIXED_INTERVAL
+#define DRIFT_MAX_PPM		   200	// limit of the correction
+
+// Discovery parks on a channel for as long as the slowest station not synchronized takes to
+// hop through all of the band's channels, and DISCOVERY_GUARD_HOPS more, then moves on. A
+// station that was lost is first looked for where its last timing puts it, in a window as
+// wide as the drift since it was heard could have moved it. DAVISRFM69_FIXED_DISCOVERY
+// parks for DISCOVERY_STEP per channel and station instead, as the driver used to.
+//#define DAVISRFM69_FIXED_DISCOVERY
+// Learn each station's carrier offset from the FEI of its packets, overall and for every
+// channel, and tune to it corrected by that, unless DAVISRFM69_FIXED_FREQ is defined
+//#define DAVISRFM69_FIXED_FREQ
 
 #define DISCOVERY_STEP   150000000L	// 150 seconds
-#define FIFO_SIZE			8
+#define DISCOVERY_GUARD_HOPS	1
+#define REACQUIRE_USEC	1800000000L	// 30 minutes, then a lost station is searched for from scratch
+
+// When the next station's window opens before the one being tuned in to closes: if both
+// packets fit one after the other, the first window is cut short where the second has to
+// begin, so a miss of the first doesn't cost the second as well. If they collide on the
+// air, one of them is given up on ahead of time, chosen by DAVISRFM69_COLLISION_POLICY.
+#define COLLIDE_NONE		0	// don't look ahead: whichever is due first, then the other if there is time left
+#define COLLIDE_FIRST		1	// the one due first
+#define COLLIDE_PRIORITY	2	// the higher Station.priority, then the one due first
+#define COLLIDE_ALTERNATE	3	// the one given up on more often so far
+#define COLLIDE_LOSS_BUDGET	4	// the one that missed fewer in a row, unless the other is about to be lost
+#define LOSS_BUDGET_RESERVE	8	// misses left before RESYNC_THRESHOLD that make a station win
+#ifndef DAVISRFM69_COLLISION_POLICY
+#define DAVISRFM69_COLLISION_POLICY COLLIDE_LOSS_BUDGET
+#endif
+#ifndef FIFO_SIZE
+#define FIFO_SIZE			8	// packets waiting for the sketch, power of 2
+#endif
+#ifndef RAW_FIFO_SIZE
+#define RAW_FIFO_SIZE		4	// packets captured by the ISR, waiting to be checked in loop(), power of 2
+#endif
+
+// How DavisRFM69Diversity uses its two radios. Either way both follow every station that
+// either of them hears, and the copy with the better RSSI is kept when both get a packet.
+#define DIVERSITY_SAME		0	// both tune in to the same station: antenna diversity
+#define DIVERSITY_SPLIT		1	// the second takes the station the first gives up on in a collision, and
+								// discovery on the second starts from the other half of the band
+
+// Check packets against the stations and update their timing in the DIO0 interrupt, as the
+// driver originally did, instead of deferring that to loop()
+//#define DAVISRFM69_RX_IN_ISR
+
+// Keep a histogram of the time spent in the driver's interrupt handlers (isrStats)
+//#define DAVISRFM69_ISR_STATS
+
+// Drain the radio FIFO with the SAMD21 DMAC: the DIO0 ISR only timestamps the packet and
+// starts the transfer, the rest runs from the DMA complete interrupt with interrupts enabled.
+//#define DAVISRFM69_DMA_FIFO
+
+// Tune in to stations from a timer compare interrupt (SAMD21 TC4/TC5) armed for the next
+// scheduled wakeup, rather than when loop() happens to be called
+//#define DAVISRFM69_TIMER_TUNE
+
+// CRC16-CCITT implementation used to check packets while the FIFO drains: 256 (512 bytes
+// of flash) or 16 (32 bytes, two lookups per byte) entry table, or 0 for the original
+// bitwise loop. Defining DAVISRFM69_CRC_DMAC on a SAMD21 makes crc16_ccitt() use the DMAC
+// CRC engine; that only affects buffers checked whole (record framing), not the packet
+// check, which runs a byte at a time as the FIFO drains.
+#ifndef DAVISRFM69_CRC_TABLE
+#define DAVISRFM69_CRC_TABLE 256
+#endif
 
 #define FREQ_TABLE_LENGTH_US 51
 #define FREQ_TABLE_LENGTH_AU 51
@@ -75,6 +157,11 @@
 #define FREQ_BAND_AU 1
 #define FREQ_BAND_EU 2
 #define FREQ_BAND_NZ 3
+#define FREQ_BAND_ANY 0xff	// DavisRFM69Radio: the band is picked in initialize()
+
+// Build DavisRFM69 for one band only: its hop table and length become constants, the other
+// tables aren't linked in, and initialize()'s band argument is ignored
+//#define DAVISRFM69_BAND FREQ_BAND_US
 
 // added these here because upstream removed them
 #define REG_TESTAFC        0x71
@@ -117,28 +204,50 @@ struct __attribute__((packed)) Station {
 	bool active;            	// true when the station is actively listened and will queue packets
 	byte repeaterId;        	// repeater id when packet is coming via a repeater, otherwise 0
 							  // repeater IDs A..H are stored as 0x8..0xf here
+	byte priority;			// wins collisions with stations of lower priority (COLLIDE_PRIORITY)
 
 	uint32_t lastRx;   	 	// last time a packet is seen or should have been seen when missed
 	uint32_t lastSeen; 	 	// last factual reception time
 	uint32_t interval;    	// packet transmit interval for the station: (41 + id) / 16 * 1M microsecs
+	uint32_t intervalQ8;	// the interval as estimated from packet timing, microseconds * 256
+	byte lastRxQ8;			// fractional microseconds of lastRx, as advanced over missed packets
 	uint32_t numResyncs;  	// number of times discovery of this station started because of packet loss
 	uint32_t packets; 		// total number of received packets after (re)restart
 	uint32_t lostPackets;     // missed packets since a packet was last seen from this station
+	uint32_t sacrificed;	// packets given up on ahead of time for another station's
 	uint32_t syncBegan; 		// time sync began for this station.
 	uint32_t recvBegan; 		// time we tuned in to receive
 	uint32_t earlyAmt;		// microseconds from when we turned on rx to when the last packet was rx'ed (for tuning, we want this small)
+	uint64_t rxOnTime;		// total microseconds the receiver was tuned in for this station
+	int32_t arrivalBias;	// moving average of packet arrival minus prediction, microseconds * 8
+	int32_t arrivalDev;		// moving average of its absolute deviation, microseconds * 4
+	uint32_t tuneLag;		// recent worst delay from planned to actual tune-in, microseconds
+	uint16_t tuneLead;		// window: tune in this long before the packet is due to end...
+	uint16_t lateThresh;	// ...and give up on it this long after
+	byte windowSamples;		// packets seen since the window was reset
+	int16_t freqOffset;		// carrier offset from the band table, in Fstep (61.035 Hz)
+	byte freqSamples;		// packets freqOffset was learned from, up to 255
+	bool phaseHint;			// lost, but lastRx, intervalQ8 and channel still predict its packets
 	byte progress;			// search(sync) progress in percent.
 	byte channel;           	// rx channel the next packet of the station is expected on (moved by amm for packing on 32 bit machines)
 	};
 
+	// Wakeup scheduler entry: when loop() has to tune in to a station
+struct WakeEntry {
+	uint32_t at;				// micros(): expected transmission minus the tune-in lead
+	byte station;				// index in stations[]
+	};
+
+#define WAKE_NONE			0xff
+
 struct __attribute__((packed)) WxData {
 	byte rain = 0;
 	uint16_t rainrate = 0;
 	uint16_t rh = 0;
 	int16_t soilleaf = -1;
-	float solar = -1;
+	int32_t solar = -1;		// 0.001 W/m2, rounded down (wxSolar()), -1 no sensor
 	int16_t temp = 0;
-	float uv = -1;
+	int16_t uv = -1;			// 0.01 UV index, -1 no sensor
 	int16_t vcap = -1;
 	int16_t vsolar = -1;
 	uint16_t windd = 0;
@@ -148,72 +257,236 @@ struct __attribute__((packed)) WxData {
 	uint16_t windv = 0;
 	};
 
+// SPI bus usage, split by what the driver was doing
+#define SPI_OP_HOP			0	// setChannel(): retune and enter RX
+#define SPI_OP_RX			1	// interruptHandler(): status, standby and FIFO drain
+#define SPI_OP_OTHER		2	// initialization, mode changes from loop(), bandwidth
+#define SPI_OP_COUNT		3
+
+struct SpiStats {
+	uint32_t calls;				// setChannel()/interruptHandler() invocations
+	uint32_t transactions;		// chip select cycles
+	uint32_t bytes;				// bytes clocked, including address bytes
+	};
+
+#define RAW_CRC_BAD			0
+#define RAW_CRC_OK			1	// CRC over bytes 0..5 matched
+#define RAW_CRC_REPEATER	2	// CRC over bytes 0..5 and 8..9 matched, as sent by repeaters
+
+	// A packet as captured by the ISR, before it is checked against the stations
+struct RawPacket {
+	byte packet[DAVIS_PACKET_LEN];
+	byte channel;				// channel the radio was tuned to
+	byte crc;					// RAW_CRC_XXX
+	byte rssi;					// -dBm
+	int16_t fei;
+	int16_t freqCorr;			// correction the channel was tuned with, Fstep
+	uint32_t time;				// micros() when DIO0 signalled the packet
+	};
+
+#define ISR_DIO0			0	// radio interrupt
+#define ISR_DMA				1	// DMA complete (DAVISRFM69_DMA_FIFO)
+#define ISR_COUNT			2
+#define ISR_HIST_BUCKETS	12	// <2, <4, <8 ... <2048, >=2048 microseconds
+
+struct IsrStats {
+	uint32_t count;
+	uint32_t maxUs;
+	uint32_t hist[ISR_HIST_BUCKETS];
+	};
+
 struct __attribute__((packed)) RadioData {
 	byte packet[DAVIS_PACKET_LEN];
 	byte channel;
 	byte rssi;
-	int16_t fei;
+	int16_t fei;				// carrier offset from the band table, Fstep, whatever the radio was tuned to
 	uint32_t delta;
 	};
 
-class DavisRFM69 {
+#include "DavisRFM69_frequencies.h"
+
+#define DAVISRFM69_MAX_RADIOS	2	// RFM69s on one MCU, each with its own CS and DIO0 pins
+
+	// One RFM69 on the SPI bus: register access, the DIO0 interrupt and capturing packets
+	// from the FIFO. What is done with them, and the hopping, is up to DavisRFM69Radio.
+	// The SPI bus, the DMA channel and the tune-in timer are shared between radios.
+class DavisRFM69Base {
 public:
-	static volatile byte packetOut, qLen;
-	RadioData packetFifo[FIFO_SIZE];
-	static volatile uint32_t lostPackets;
-	static volatile uint32_t packets;
-	static volatile byte numStations;
-	static volatile enum sm_mode mode;
-	static Station *stations;
-
-	DavisRFM69(byte slaveSelectPin, byte interruptPin, byte interruptNum) {
-		_slaveSelectPin = slaveSelectPin;
-		_interruptPin = interruptPin;
-		_interruptNum = interruptNum;
-		_mode = RF69_MODE_STANDBY;
-		}
+	volatile SpiStats spiStats[SPI_OP_COUNT];
+	volatile IsrStats isrStats[ISR_COUNT];
+	volatile uint32_t crcErrors;		// packets that failed both CRC checks
+	uint32_t rawDropped() { return rawFifo.dropped; }	// good packets lost because loop() fell behind
+
+	DavisRFM69Base(byte slaveSelectPin, byte interruptPin, byte interruptNum);
 
-	void initialize(byte freqBand);
 	void setBandwidth(byte bw);
-	void loop();
+
+	static uint16_t crc16_ccitt(volatile byte *buf, byte len, uint16_t initCrc = 0);
+	static uint16_t crc16_ccitt_bitwise(volatile byte *buf, byte len, uint16_t crc);
+	static uint16_t crc16_ccitt_tab16(volatile byte *buf, byte len, uint16_t crc);
+	static uint16_t crc16_ccitt_tab256(volatile byte *buf, byte len, uint16_t crc);
 
 protected:
-	static volatile byte packetIn;
-	static volatile byte DATA[DAVIS_PACKET_LEN];
-	static volatile byte _mode;
-	static volatile byte CHANNEL;
-	static volatile int RSSI;
-	static volatile int16_t FEI;
-	static volatile byte band;
-	static volatile uint32_t numResyncs;
-	static volatile uint32_t lostStations;
-	static volatile byte stationsFound;
-	static volatile byte curStation;
-
-	static DavisRFM69* selfPointer;
+	volatile byte _mode;
+	volatile byte CHANNEL;
+	volatile int16_t freqCorr;			// FRF correction CHANNEL is tuned with, Fstep
+	volatile uint32_t RXTIME;			// micros() when DIO0 signalled the packet
+	SpscQueue<RawPacket, RAW_FIFO_SIZE> rawFifo;	// ISR -> loop(); dropped: loop() fell behind
+	RawPacket rawScratch;				// capture buffer when rawFifo is full
+	volatile byte spiOp;
 
 	byte _slaveSelectPin;
 	byte _interruptPin;
 	byte _interruptNum;
 
-	void setChannel(byte channel);
-	static uint16_t crc16_ccitt(volatile byte *buf, byte len, uint16_t initCrc = 0);
+	static DavisRFM69Base *radios[DAVISRFM69_MAX_RADIOS];	// whose DIO0 isr0, isr1... are
+	static volatile bool dmaBusy;		// a DMA FIFO transfer owns the SPI bus
+	static DavisRFM69Base *dmaOwner;	// ...for this radio
+	static DavisRFM69Base *volatile dmaWaiting;	// a radio with a packet ready meanwhile
+	static byte dmaTx[DAVIS_PACKET_LEN + 1];
+	static byte dmaRx[DAVIS_PACKET_LEN + 1];
+	static byte dmaStatus[8];			// FEIMSB..IRQFLAGS2 of dmaOwner, read before its transfer
+	static DavisRFM69Base *timerOwner;	// the radio the tune-in timer works for
+
+	void begin();
+		// tuned in to stations by the timer interrupt rather than from loop(): there is one
+		// timer (DAVISRFM69_TIMER_TUNE), for the first radio initialized
+	bool timerTuned() const {
+#ifdef DAVISRFM69_TIMER_TUNE
+		return timerOwner == this;
+#else
+		return false;
+#endif
+		}
 	byte readReg(byte addr);
 	void writeReg(byte addr, byte val);
-	byte nextChannel(byte channel);
-	int findStation(byte id);
-	void handleRadioInt();
-	uint32_t difftime(uint32_t after, uint32_t before);
-	void nextStation();
-	void(*userInterrupt)();
+	void readBurst(byte addr, byte *buf, byte len);
+	void writeBurst(byte addr, const byte *buf, byte len);
+	RawPacket *rawSlot();
+		// a packet has been captured, or is being, that loop() hasn't handled yet
+	bool capturing() const {
+		return !rawFifo.empty() || (dmaBusy && dmaOwner == this) || dmaWaiting == this;
+		}
+	virtual void rxCaptured(RawPacket *rp) = 0;
+#ifdef DAVISRFM69_TIMER_TUNE
+	virtual void timerTune() = 0;
+#endif
 	void virtual interruptHandler();
-	byte reverseBits(byte b);
+	static void isrDispatch(byte radio);
 	static void isr0();
+	static void isr1();
+	static void dmaDone();
+	static void tuneTimerFired();
+	void startDma();
+	void dmaComplete();
+	void drainFifo(const byte *fifo, RawPacket *rp);
+	void isrTimed(byte which, uint32_t start);
+	static byte reverseBits(byte b);
+	static uint32_t difftime(uint32_t after, uint32_t before);
+	static uint32_t nominalInterval(byte id);
 	void setMode(byte mode);
 	void select();
 	void unselect();
 	};
 
-	// FRF_MSB, FRF_MID, and FRF_LSB for the 51 North American, Australian, New Zealander & 5 European channels
-	// used by Davis in frequency hopping
+	// A Davis receiver on one RFM69: finds the stations, follows their hopping and queues
+	// their packets for the sketch. Band is a FREQ_BAND_XX, or FREQ_BAND_ANY to pick it in
+	// initialize(); up to MaxStations stations; FifoDepth packets waiting for the sketch.
+	// All of its state is its own, so more than one can run side by side.
+template <byte Band, byte MaxStations, byte FifoDepth>
+class DavisRFM69Radio : public DavisRFM69Base {
+	static_assert(MaxStations > 0 && MaxStations < WAKE_NONE, "MaxStations must be 1..254");
+
+public:
+	typedef SpscQueue<RadioData, FifoDepth> PacketQueue;
+	PacketQueue packetFifo;				// received packets, for the sketch to peek() and pop()
+	volatile uint32_t lostPackets;
+	volatile uint32_t packets;
+	volatile byte numStations;
+	volatile enum sm_mode mode;
+	Station stations[MaxStations];
+
+	DavisRFM69Radio(byte slaveSelectPin, byte interruptPin, byte interruptNum)
+		: DavisRFM69Base(slaveSelectPin, interruptPin, interruptNum), lostPackets(0), packets(0),
+		numStations(0), mode(SM_IDLE), band(Band == FREQ_BAND_ANY ? FREQ_BAND_US : Band), partner(NULL),
+		complements(false) {
+		}
+
+	void setStations(const Station *config, byte count);
+	void pair(DavisRFM69Radio *other, bool complement);
+	void initialize(byte freqBand);
+	void loop();
+	uint32_t idleTime();
+		// index in stations[] of the station with this ID, -1 if it isn't one of them
+	int findStation(byte id);
+
+protected:
+	typedef BandTable<Band> Hops;
+
+	int8_t chanOffset[MaxStations][Hops::MAX_LENGTH];	// per channel, on top of Station.freqOffset
+	byte band;
+	uint32_t numResyncs;
+	uint32_t lostStations;
+	byte stationsFound;
+	volatile byte curStation;
+	uint32_t recvWindow;				// how long to wait for curStation's packet from recvBegan
+	byte searchChannel;					// channel discovery is parked on...
+	uint32_t searchBegan;				// ...since then, 0 when not searching
+	byte searchProgress;
+	WakeEntry wakeHeap[MaxStations];	// min-heap on at, of the synchronized stations
+	byte wakePos[MaxStations];			// heap index of each station, WAKE_NONE if not in it
+	byte wakeLen;
+	volatile bool inLoop;				// its or its partner's loop() is running, a timer tune-in has to wait
+	volatile bool tunePending;
+	DavisRFM69Radio *partner;			// the other radio of a pair, or NULL
+	bool complements;					// ...and this one covers what it gives up on
+
+	void setChannel(byte channel, int16_t offset = 0);
+	int16_t freqCorrection(byte st, byte channel);
+	void learnOffset(byte st, RawPacket *rp);
+	byte nextChannel(byte channel);
+	void handleRadioInt(RawPacket *rp);
+	void stationFound(byte st);
+	void stationHeard(byte st, uint32_t time, byte channel, bool wasSynced);
+	void partnerHeard(byte st, uint32_t time, byte channel);
+	bool heardAlready(byte st, uint32_t time);
+	void rxCaptured(RawPacket *rp);
+	void processRaw();
+	void service();
+	void resetWindow(byte st);
+	void adaptWindow(byte st, int32_t err);
+	void setWindow(byte st);
+	uint32_t wakeTime(byte st);
+	uint32_t windowLead(byte st);
+	uint32_t windowLate(byte st);
+	void trackDrift(byte st, uint32_t sinceSeen);
+	void skipPacket(byte st);
+	void advancePhase(byte st);
+	uint32_t discoveryDwell();
+	bool reacquire(byte st);
+	bool search();
+	void tuneIn(byte st);
+	byte arbitrate(byte st);
+	byte collisionWinner(byte first, byte second);
+#ifdef DAVISRFM69_TIMER_TUNE
+	void timerTune();
+	void loopDone();
+	void tuneDue();
+#endif
+	void schedule(byte st);
+	void reschedule(byte st);
+	void unschedule(byte st);
+	void wakeSwap(byte a, byte b);
+	void wakeSiftUp(byte i);
+	void wakeSiftDown(byte i);
+	};
+
+#ifdef DAVISRFM69_BAND
+typedef DavisRFM69Radio<DAVISRFM69_BAND, MAX_STATIONS, FIFO_SIZE> DavisRFM69;
+#else
+typedef DavisRFM69Radio<FREQ_BAND_ANY, MAX_STATIONS, FIFO_SIZE> DavisRFM69;
+#endif
+
+#include "DavisRFM69_impl.h"
+
 #endif  // DAVISRFM_h
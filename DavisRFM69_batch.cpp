@@ -0,0 +1,87 @@
+// Batched summary output, see DavisRFM69_batch.h.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include "DavisRFM69_batch.h"
+#include "DavisRFM69_decode.h"
+
+WxBatcher::WxBatcher(uint16_t everyPackets, uint32_t everyMs)
+	: everyPackets(everyPackets > 0xff ? 0xff : everyPackets), everyMs(everyMs), pending(0), startMs(0) {
+	memset(sums, 0, sizeof(sums));
+	memset(rainBase, 0xff, sizeof(rainBase));
+	}
+
+void WxBatcher::add(const RadioData &rd, const WxData &wx, uint32_t now) {
+	byte st = rd.packet[0] & 0x7;
+	WxSummary &s = sums[st];
+	if (pending++ == 0) startMs = now;
+	if (s.count == 0) {
+		s.flags = 0;
+		s.windMin = 0xff;
+		s.windMax = 0;
+		s.windgust = wx.windgust;
+		s.windgustd = wx.windgustd;
+		s.tempMin = INT16_MAX;
+		s.tempMax = INT16_MIN;
+		s.rainrate = 0;
+		windSum[st] = 0;
+		rssiSum[st] = 0;
+		}
+	if (s.count < 0xff) s.count++;
+	if (rd.packet[0] & 0x8) s.flags |= WXREC_BATT_LOW;
+	rssiSum[st] += rd.rssi;
+	uint8_t windv = wx.windv > 0xff ? 0xff : wx.windv;
+	windSum[st] += windv;
+	if (windv < s.windMin) s.windMin = windv;
+	if (windv > s.windMax) s.windMax = windv;
+	if ((rd.packet[0] >> 4) == VP2P_WINDGUST && wx.windgust >= s.windgust) {
+		s.windgust = wx.windgust;
+		s.windgustd = wx.windgustd;
+		}
+	if ((rd.packet[0] >> 4) == VP2P_TEMP) {
+		if (wx.temp < s.tempMin) s.tempMin = wx.temp;
+		if (wx.temp > s.tempMax) s.tempMax = wx.temp;
+		}
+	// WxData's rain is 0 until the station's first rain packet: count from that one
+	if ((rd.packet[0] >> 4) == VP2P_RAIN && rainBase[st] == 0xff && wx.rain < 0x80) rainBase[st] = wx.rain;
+	if (wx.rainrate > s.rainrate) s.rainrate = wx.rainrate;
+	// the rest as they are last
+	s.windd = wx.windd;
+	s.temp = wx.temp;
+	s.rh = wx.rh;
+	s.solar = wxRound(wx.solar, 3, 1);
+	s.uv = wx.uv;
+	s.vcap = wx.vcap;
+	s.vsolar = wx.vsolar;
+	s.soilleaf = wx.soilleaf;
+	s.rain = wx.rain;			// the counter until nextFrame() makes it the tips
+	}
+
+size_t WxBatcher::nextFrame(uint8_t *frame, uint32_t packets, uint32_t lostPackets, uint32_t now) {
+	for (byte st = 0; st < 8; st++) {
+		WxSummary &s = sums[st];
+		if (s.count == 0) continue;
+		struct __attribute__((packed)) {
+			WxSummary s;
+			uint8_t crc[2];
+			} f;
+		f.s = s;
+		f.s.kind = WXREC_SUMMARY;
+		f.s.station = st;
+		f.s.seconds = (now - startMs + 500) / 1000;
+		f.s.rssi = (rssiSum[st] + s.count / 2) / s.count;
+		f.s.packets = packets;
+		f.s.lostPackets = lostPackets;
+		f.s.windAvg = (windSum[st] * 10 + s.count / 2) / s.count;
+		if (s.tempMin > s.tempMax) f.s.tempMin = f.s.tempMax = s.temp;		// no temperature packet in the batch
+		// tips since the last summary: the counter wraps at 128, 255 is no reading; none
+		// before a rain packet has set the base
+		f.s.rain = s.rain < 0x80 && rainBase[st] < 0x80 ? (s.rain - rainBase[st]) & 0x7f : 0;
+		if (s.rain < 0x80 && rainBase[st] != 0xff) rainBase[st] = s.rain;
+		s.count = 0;
+		return wxFrame(frame, (uint8_t *) &f, sizeof(f.s));
+		}
+	pending = 0;
+	return 0;
+	}
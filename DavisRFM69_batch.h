@@ -0,0 +1,54 @@
+// Batched output: a summary per station every so many packets or seconds, instead of a
+// record per packet.
+//
+// add() takes each decoded packet into its station's running summary, a WxSummary being
+// filled in place (mean RSSI and wind, wind and temperature range, highest gust and rain
+// rate, rain tips, the last of the other readings). The batch is due after
+// everyPackets packets or everyMs milliseconds from its first packet, whichever comes
+// first; then nextFrame() hands out one framed summary per station heard (see
+// DavisRFM69_record.h) and starts the next batch.
+//
+//   batch.add(*rd, wx, millis());
+//   ...
+//   if (batch.due(millis())) {
+//       byte frame[WXREC_SUMMARY_FRAME_MAX];
+//       while (size_t n = batch.nextFrame(frame, radio.packets, radio.lostPackets, millis()))
+//           Serial.write(frame, n);
+//       }
+
+#ifndef DAVISRFM69_BATCH_h
+#define DAVISRFM69_BATCH_h
+
+#include "DavisRFM69.h"
+#include "DavisRFM69_record.h"
+
+#define WXBATCH_PACKETS		24		// default batch: a minute of two stations' packets
+#define WXBATCH_MS			60000	// ...or a minute, when packets are missed
+
+class WxBatcher {
+public:
+	uint16_t everyPackets;		// up to 255, what a station's count holds
+	uint32_t everyMs;
+	uint16_t pending;			// packets in the current batch
+
+	WxBatcher(uint16_t everyPackets = WXBATCH_PACKETS, uint32_t everyMs = WXBATCH_MS);
+
+		// A decoded packet, with its station's readings after it, received at now (millis())
+	void add(const RadioData &rd, const WxData &wx, uint32_t now);
+		// the batch is complete: flush it with nextFrame()
+	bool due(uint32_t now) const {
+		return pending >= everyPackets || (pending > 0 && now - startMs >= everyMs);
+		}
+		// The next station's summary into frame (WXREC_SUMMARY_FRAME_MAX bytes); returns its
+		// length, 0 when all were handed out and the next batch begins
+	size_t nextFrame(uint8_t *frame, uint32_t packets, uint32_t lostPackets, uint32_t now);
+
+private:
+	WxSummary sums[8];
+	uint16_t windSum[8];		// mph, over the station's packets in the batch
+	uint8_t rainBase[8];		// rain counter at the station's previous summary, 0xff no rain packet yet
+	uint16_t rssiSum[8];
+	uint32_t startMs;			// millis() of the batch's first packet
+	};
+
+#endif  // DAVISRFM69_BATCH_h
@@ -0,0 +1,129 @@
+// Integer decoding of the readings decode_packet() computed in floating point.
+//
+// The SAMD21's Cortex-M0+ has no FPU, so every float and double operation, and round(),
+// is a soft-float library call. These give the values the float expressions gave,
+// rounded the same way (round() is half away from zero), with integer multiplies and
+// shifts: x * 1.341176 rounded is (x * 10987 + 4096) >> 13 over every x a packet can
+// hold, and so on. Only the rain rate needs a division.
+//
+// UV and solar radiation were floats, printed with 2 decimals on the "c:" line, 1 in the
+// debug output, and rounded to WxRecord's hundredths and tenths. They are kept in units
+// fine enough that wxRound() and wxPrintFixed() give each of those exactly as before.
+//
+// The one difference: when it isn't raining the rain rate was round(3600.0 / 0), an
+// infinity converted to uint16_t, which is undefined; it is 0 now.
+//
+// The float originals are kept below them, for host/bench_decode, which checks every raw
+// value against them, printed text included, and the sketch's DECODE_BENCH, which counts
+// the cycles of both.
+
+#ifndef DAVISRFM69_DECODE_h
+#define DAVISRFM69_DECODE_h
+
+#include <math.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+#include "DavisRFM69_record.h"
+
+	// Wind direction in degrees, 0 without an anemometer (packet[2] == 0)
+static inline uint16_t wxWindDir(const uint8_t *packet, bool vue) {
+	if (packet[2] == 0) return 0;
+	if (vue) return (((packet[2] << 1) | (packet[4] & 2) >> 1) * 45 + 32) >> 6;		// * 0.703125
+	uint16_t windd = 9 + (((packet[2] - 1) * 10987 + 4096) >> 13);					// * 1.341176
+	if (windd > 345) windd = ((windd - 345) * 2) + 345;		// smooths out the dead zone around N like the console
+	return windd;
+	}
+
+	// UV index in hundredths, WXREC_NONE without a sensor
+static inline int16_t wxUv(const uint8_t *packet) {
+	uint16_t raw = (packet[3] << 8 | packet[4]) >> 6;
+	return raw < 0x3ff ? raw * 2 : WXREC_NONE;						// / 50
+	}
+
+	// Solar radiation in 0.001 W/m2, rounded down, WXREC_NONE without a sensor. Rounding
+	// that to hundredths or tenths rounds the exact value, as the float did.
+static inline int32_t wxSolar(const uint8_t *packet) {
+	uint16_t raw = (packet[3] << 8 | packet[4]) >> 6;
+	return raw < 0x3fe ? raw * 1757L + ((raw * 61342UL) >> 16) : WXREC_NONE;	// * 1757.936
+	}
+
+	// Rain rate in 0.01"/hr from the seconds between the last tips (10 bits in light rain,
+	// the top 6 in strong rain: packet[4] bit 6 clear), 0 when it isn't raining
+static inline uint16_t wxRainRate(const uint8_t *packet) {
+	uint16_t secs = (packet[4] & 0x30) << 4 | packet[3];
+	if (secs == 0x3ff) return 0;
+	if ((packet[4] & 0x40) == 0) secs >>= 4;
+	return secs ? (7200 + secs) / (2 * secs) : 0;					// 3600 / secs, rounded
+	}
+
+	// value in 10^-scale units to 10^-decimals, rounded half up; WXREC_NONE stays
+static inline int32_t wxRound(int32_t value, uint8_t scale, uint8_t decimals) {
+	if (value < 0) return WXREC_NONE;
+	uint32_t div = 1;
+	while (scale-- > decimals) div *= 10;
+	return (value + div / 2) / div;
+	}
+
+	// value in 10^-scale units as Print prints a float of it with decimals digits;
+	// WXREC_NONE as -1
+static inline void wxPrintFixed(int32_t value, uint8_t scale, uint8_t decimals) {
+	uint32_t unit = 1;
+	for (uint8_t i = 0; i < decimals; i++) unit *= 10;
+	uint32_t v;
+	if (value < 0) {
+		Serial.print('-');
+		v = unit;
+		}
+	else v = wxRound(value, scale, decimals);
+	Serial.print(v / unit);
+	if (decimals == 0) return;
+	Serial.print('.');
+	for (uint32_t d = unit / 10; d > 0; d /= 10) Serial.print((char) ('0' + v / d % 10));
+	}
+
+// The float originals. wxRainRateFloat() divides by 0 when it isn't raining, as the
+// original did: callers leave those inputs out (wxRainRateZero()).
+
+static inline uint16_t wxWindDirFloat(const uint8_t *packet, bool vue) {
+	if (packet[2] == 0) return 0;
+	if (vue) return round(((packet[2] << 1) | (packet[4] & 2) >> 1) * 0.703125);
+	uint16_t windd = 9 + round((packet[2] - 1) * 1.341176);
+	if (windd > 345) windd = ((windd - 345) * 2) + 345;
+	return windd;
+	}
+
+	// as WxRecord got it from WxData's float
+static inline int16_t wxFixedFloat(float v, int16_t scale) {
+	return v < 0 ? WXREC_NONE : (int16_t) (v * scale + 0.5f);
+	}
+
+static inline float wxUvFloat(const uint8_t *packet) {
+	float uv = (packet[3] << 8 | packet[4]) >> 6;
+	if (uv < 0x3ff) uv = (uv / 50.0);
+	else uv = -1;
+	return uv;
+	}
+
+static inline float wxSolarFloat(const uint8_t *packet) {
+	float solar = (packet[3] << 8 | packet[4]) >> 6;
+	if (solar < 0x3fe) solar = (solar * 1.757936);
+	else solar = -1;
+	return solar;
+	}
+
+static inline bool wxRainRateZero(const uint8_t *packet) {
+	uint16_t secs = (packet[4] & 0x30) << 4 | packet[3];
+	if (secs == 0x3ff) return true;
+	if ((packet[4] & 0x40) == 0) secs >>= 4;
+	return secs == 0;
+	}
+
+static inline uint16_t wxRainRateFloat(const uint8_t *packet) {
+	uint16_t rainrate = (packet[4] & 0x30) << 4 | packet[3];
+	if (rainrate == 0x3ff) rainrate = 0;
+	else if ((packet[4] & 0x40) == 0) rainrate >>= 4;
+	return round(3600.0 / rainrate);
+	}
+
+#endif  // DAVISRFM69_DECODE_h
@@ -0,0 +1,125 @@
+// Two RFM69s on one MCU, as one receiver.
+//
+// Each radio is a DavisRFM69Radio on its own chip select and DIO0 pin, with the same
+// stations; pair() makes each follow the stations' timing from what either of them hears.
+// How the second one is used otherwise is the mode, DIVERSITY_SAME or DIVERSITY_SPLIT.
+// loop() runs both and merges their packets into packetFifo: when both radios got a
+// packet the copy with the better RSSI is kept, and a copy that comes in after its twin
+// was passed on is dropped.
+//
+//   DavisRFM69 radio1(SPI_CS, RF69_IRQ_PIN, RF69_IRQ_NUM);
+//   DavisRFM69 radio2(SPI_CS_2, RF69_IRQ_PIN_2, RF69_IRQ_NUM_2);
+//   DavisRFM69Diversity<DavisRFM69> radio(radio1, radio2, DIVERSITY_SPLIT);
+
+#ifndef DAVISRFM69_DIVERSITY_h
+#define DAVISRFM69_DIVERSITY_h
+
+#include <string.h>
+
+#include "DavisRFM69.h"
+
+template <class Radio>
+class DavisRFM69Diversity {
+public:
+	typename Radio::PacketQueue packetFifo;	// merged packets, for the sketch to peek() and pop()
+	uint32_t packets;			// packets passed on
+	uint32_t duplicates;		// second copies dropped
+	uint32_t secondOnly;		// packets passed on that only the second radio got
+	Radio &first;
+	Radio &second;
+
+	DavisRFM69Diversity(Radio &radio1, Radio &radio2, byte mode)
+		: packets(0), duplicates(0), secondOnly(0), first(radio1), second(radio2), mode(mode) {
+		memset(last, 0, sizeof(last));
+		memset(lastAt, 0, sizeof(lastAt));
+		}
+
+	void setStations(const Station *config, byte count) {
+		first.setStations(config, count);
+		second.setStations(config, count);
+		}
+
+	void initialize(byte freqBand) {
+		first.pair(&second, false);
+		second.pair(&first, mode == DIVERSITY_SPLIT);
+		first.initialize(freqBand);
+		second.initialize(freqBand);
+		}
+
+	void setBandwidth(byte bw) {
+		first.setBandwidth(bw);
+		second.setBandwidth(bw);
+		}
+
+	void loop() {
+		first.loop();
+		second.loop();
+		merge();
+		}
+
+		// microseconds until either radio needs loop() again
+	uint32_t idleTime() {
+		uint32_t a = first.idleTime(), b = second.idleTime();
+		return a < b ? a : b;
+		}
+
+		// whether station st is being followed, by either radio
+	bool synced(byte st) const {
+		if (st >= first.numStations) return false;
+		return first.stations[st].interval != 0 || second.stations[st].interval != 0;
+		}
+
+protected:
+	byte mode;
+	RadioData last[8];			// the last packet passed on for each station id
+	uint32_t lastAt[8];			// ...and micros() then
+
+	static bool sameTransmission(const RadioData &a, const RadioData &b) {
+		return a.channel == b.channel && !memcmp(a.packet, b.packet, DAVIS_PACKET_LEN);
+		}
+
+	void merge() {
+		for (;;) {
+			RadioData *a = first.packetFifo.peek();
+			RadioData *b = second.packetFifo.peek();
+			if (a != NULL && b != NULL && sameTransmission(*a, *b)) {
+				// rssi is -dBm: the lower, the stronger. The radio that handled its copy
+				// second already had its station timed by the other's, so its delta is ~0.
+				RadioData best = b->rssi < a->rssi ? *b : *a;
+				if (a->delta > best.delta) best.delta = a->delta;
+				if (b->delta > best.delta) best.delta = b->delta;
+				pass(best, false);
+				duplicates++;
+				first.packetFifo.pop();
+				second.packetFifo.pop();
+				}
+			else if (a != NULL) {
+				pass(*a, false);
+				first.packetFifo.pop();
+				}
+			else if (b != NULL) {
+				pass(*b, true);
+				second.packetFifo.pop();
+				}
+			else break;
+			}
+		}
+
+		// Queue p for the sketch, unless its twin from the other radio already was: that
+		// comes in a loop() or two later, well within a station's shortest interval
+	void pass(const RadioData &p, bool fromSecond) {
+		byte id = p.packet[0] & 0x7;
+		uint32_t now = micros();
+		if (sameTransmission(p, last[id]) && now - lastAt[id] < 1000000UL) {
+			duplicates++;
+			return;
+			}
+		last[id] = p;
+		lastAt[id] = now;
+		packets++;
+		if (fromSecond) secondOnly++;
+		packetFifo.push(p);
+		}
+	};
+
+#endif  // DAVISRFM69_DIVERSITY_h
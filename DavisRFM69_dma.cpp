@@ -0,0 +1,86 @@
+// SAMD21 DMAC implementation of the SPI DMA used by DavisRFM69 (DAVISRFM69_DMA_FIFO).
+//
+// Two channels move bytes between RAM and the SERCOM the radio is on: one feeds DATA on
+// the "TX empty" trigger, the other empties it on "RX complete" and raises the interrupt
+// when the last byte has arrived.
+//
+// This defines DMAC_Handler, so it can't be combined with another DMA library in the sketch.
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+
+#if defined(DAVISRFM69_DMA_FIFO) && defined(ARDUINO_ARCH_SAMD)
+
+#include "DavisRFM69_dma.h"
+
+// The Feather M0's SPI pins (and the on-board RFM69) are on SERCOM4
+#define DMA_SERCOM	SERCOM4
+#define DMA_TRIG_RX	SERCOM4_DMAC_ID_RX
+#define DMA_TRIG_TX	SERCOM4_DMAC_ID_TX
+#define DMA_CH_RX	0
+#define DMA_CH_TX	1
+
+static DmacDescriptor descriptors[2] __attribute__((aligned(16)));
+static volatile DmacDescriptor writeback[2] __attribute__((aligned(16)));
+static void (*doneCallback)();
+
+static void setupChannel(byte ch, byte trigger, bool interrupt) {
+	DMAC->CHID.reg = DMAC_CHID_ID(ch);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigger) | DMAC_CHCTRLB_TRIGACT_BEAT;
+	if (interrupt) DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;
+	}
+
+void spiDmaBegin() {
+	PM->AHBMASK.bit.DMAC_ = 1;
+	PM->APBBMASK.bit.DMAC_ = 1;
+
+	DMAC->CTRL.bit.DMAENABLE = 0;
+	DMAC->CTRL.bit.SWRST = 1;
+	while (DMAC->CTRL.bit.SWRST);
+	DMAC->BASEADDR.reg = (uint32_t) descriptors;
+	DMAC->WRBADDR.reg = (uint32_t) writeback;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+
+	setupChannel(DMA_CH_RX, DMA_TRIG_RX, true);
+	setupChannel(DMA_CH_TX, DMA_TRIG_TX, false);
+
+	NVIC_EnableIRQ(DMAC_IRQn);
+	}
+
+void spiDmaTransfer(const byte *tx, byte *rx, uint16_t len, void (*done)()) {
+	doneCallback = done;
+
+	// with address increment the descriptor holds the address *after* the last beat
+	DmacDescriptor *d = &descriptors[DMA_CH_RX];
+	d->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_DSTINC;
+	d->BTCNT.reg = len;
+	d->SRCADDR.reg = (uint32_t) &DMA_SERCOM->SPI.DATA.reg;
+	d->DSTADDR.reg = (uint32_t) (rx + len);
+	d->DESCADDR.reg = 0;
+
+	d = &descriptors[DMA_CH_TX];
+	d->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_SRCINC;
+	d->BTCNT.reg = len;
+	d->SRCADDR.reg = (uint32_t) (tx + len);
+	d->DSTADDR.reg = (uint32_t) &DMA_SERCOM->SPI.DATA.reg;
+	d->DESCADDR.reg = 0;
+
+	// receiver first, so no byte can arrive before it is armed
+	DMAC->CHID.reg = DMAC_CHID_ID(DMA_CH_RX);
+	DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+	DMAC->CHID.reg = DMAC_CHID_ID(DMA_CH_TX);
+	DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+	}
+
+extern "C" void DMAC_Handler(void) {
+	DMAC->CHID.reg = DMAC_CHID_ID(DMA_CH_RX);
+	if (DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) {
+		DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+		if (doneCallback) doneCallback();
+		}
+	}
+
+#endif  // DAVISRFM69_DMA_FIFO && ARDUINO_ARCH_SAMD
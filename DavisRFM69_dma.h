@@ -0,0 +1,16 @@
+// SPI DMA used by DavisRFM69 to drain the radio FIFO without the CPU (DAVISRFM69_DMA_FIFO).
+//
+// Implemented with the SAMD21 DMAC in DavisRFM69_dma.cpp, and by the simulated DMAC in
+// host/SpiDmaSim.cpp for host builds. The caller drives chip select itself.
+
+#ifndef DAVISRFM69_DMA_h
+#define DAVISRFM69_DMA_h
+
+	// One-time setup of the DMA channels, called from DavisRFM69::initialize()
+void spiDmaBegin();
+
+	// Clock len bytes out of tx while storing what comes back in rx, then call done from the
+	// DMA complete interrupt. Only one transfer may be in flight.
+void spiDmaTransfer(const byte *tx, byte *rx, uint16_t len, void (*done)());
+
+#endif  // DAVISRFM69_DMA_h
@@ -19,187 +19,99 @@
 #ifndef DAVISRFM69_FREQUENCIES_h
 #define DAVISRFM69_FREQUENCIES_h
 
-typedef uint8_t FRF_ITEM[3];
+#include <stdint.h>
 
-static const __attribute__((progmem)) FRF_ITEM FRF_US[FREQ_TABLE_LENGTH_US] =
+// Channel frequencies in Hz for each band, in the order Davis hops through them. The FRF
+// register values (Fstep = 32 MHz / 2^19, about 61 Hz) are worked out from them by the
+// compiler, so a new band is a list of frequencies, its FREQ_TABLE_LENGTH_XX and a range
+// check below.
+
+static constexpr uint32_t HZ_US[] =
 	{
-	  {0xE3, 0xDA, 0x7C},
-	  {0xE1, 0x98, 0x71},
-	  {0xE3, 0xFA, 0x92},
-	  {0xE6, 0xBD, 0x01},
-	  {0xE4, 0xBB, 0x4D},
-	  {0xE2, 0x99, 0x56},
-	  {0xE7, 0x7D, 0xBC},
-	  {0xE5, 0x9C, 0x0E},
-	  {0xE3, 0x39, 0xE6},
-	  {0xE6, 0x1C, 0x81},
-	  {0xE4, 0x5A, 0xE8},
-	  {0xE1, 0xF8, 0xD6},
-	  {0xE5, 0x3B, 0xBF},
-	  {0xE7, 0x1D, 0x5F},
-	  {0xE3, 0x9A, 0x3C},
-	  {0xE2, 0x39, 0x00},
-	  {0xE4, 0xFB, 0x77},
-	  {0xE6, 0x5C, 0xB2},
-	  {0xE2, 0xD9, 0x90},
-	  {0xE7, 0xBD, 0xEE},
-	  {0xE4, 0x3A, 0xD2},
-	  {0xE1, 0xD8, 0xAA},
-	  {0xE5, 0x5B, 0xCD},
-	  {0xE6, 0xDD, 0x34},
-	  {0xE3, 0x5A, 0x0A},
-	  {0xE7, 0x9D, 0xD9},
-	  {0xE2, 0x79, 0x41},
-	  {0xE4, 0x9B, 0x28},
-	  {0xE5, 0xDC, 0x40},
-	  {0xE7, 0x3D, 0x74},
-	  {0xE1, 0xB8, 0x9C},
-	  {0xE3, 0xBA, 0x60},
-	  {0xE6, 0x7C, 0xC8},
-	  {0xE4, 0xDB, 0x62},
-	  {0xE2, 0xB9, 0x7A},
-	  {0xE5, 0x7B, 0xE2},
-	  {0xE7, 0xDE, 0x12},
-	  {0xE6, 0x3C, 0x9D},
-	  {0xE3, 0x19, 0xC9},
-	  {0xE4, 0x1A, 0xB6},
-	  {0xE5, 0xBC, 0x2B},
-	  {0xE2, 0x18, 0xEB},
-	  {0xE6, 0xFD, 0x42},
-	  {0xE5, 0x1B, 0xA3},
-	  {0xE3, 0x7A, 0x2E},
-	  {0xE5, 0xFC, 0x64},
-	  {0xE2, 0x59, 0x16},
-	  {0xE6, 0x9C, 0xEC},
-	  {0xE2, 0xF9, 0xAC},
-	  {0xE4, 0x7B, 0x0C},
-	  {0xE7, 0x5D, 0x98}
+	911413818, 902381897, 911915161, 922953186, 914926575, 906395874,
+	925964600, 918438354, 908904663, 920445374, 913420410, 903888062,
+	916933533, 924458923, 910409912, 904890625, 915929138, 921448364,
+	907399414, 926967651, 912919067, 903385376, 917434387, 923456299,
+	909406860, 926466370, 905894592, 914424316, 919441406, 924960205,
+	902884521, 910912109, 921949707, 915427856, 906898071, 917935669,
+	927469849, 920947083, 908402893, 912417358, 918940125, 904389343,
+	923957153, 916431824, 909909058, 919943604, 905391968, 922451904,
+	907901123, 913922607, 925462402
 	};
 
-static const __attribute__((progmem)) FRF_ITEM FRF_AU[FREQ_TABLE_LENGTH_AU] =
+static constexpr uint32_t HZ_AU[] =
 	{
-	   {0xE5, 0x84, 0xDD},
-	   {0xE6, 0x43, 0x43},
-	   {0xE7, 0x1F, 0xCE},
-	   {0xE6, 0x7F, 0x7C},
-	   {0xE5, 0xD5, 0x0E},
-	   {0xE7, 0x5B, 0xF7},
-	   {0xE6, 0xC5, 0x81},
-	   {0xE6, 0x07, 0x2B},
-	   {0xE6, 0xED, 0xA1},
-	   {0xE6, 0x61, 0x58},
-	   {0xE5, 0xA3, 0x02},
-	   {0xE6, 0xA7, 0x8D},
-	   {0xE7, 0x3D, 0xB2},
-	   {0xE6, 0x25, 0x3F},
-	   {0xE5, 0xB7, 0x0A},
-	   {0xE6, 0x93, 0x85},
-	   {0xE7, 0x01, 0xDB},
-	   {0xE5, 0xE9, 0x26},
-	   {0xE7, 0x70, 0x00},
-	   {0xE6, 0x57, 0x6C},
-	   {0xE5, 0x98, 0xF5},
-	   {0xE6, 0xB1, 0x99},
-	   {0xE7, 0x29, 0xDB},
-	   {0xE6, 0x11, 0x37},
-	   {0xE7, 0x65, 0xE3},
-	   {0xE5, 0xCB, 0x33},
-	   {0xE6, 0x75, 0x60},
-	   {0xE6, 0xD9, 0xA9},
-	   {0xE7, 0x47, 0xDF},
-	   {0xE5, 0x8E, 0xF9},
-	   {0xE6, 0x2F, 0x4B},
-	   {0xE7, 0x0B, 0xB6},
-	   {0xE6, 0x89, 0x68},
-	   {0xE5, 0xDF, 0x2B},
-	   {0xE6, 0xBB, 0xA5},
-	   {0xE7, 0x79, 0xFB},
-	   {0xE6, 0xF7, 0xAE},
-	   {0xE5, 0xFD, 0x2F},
-	   {0xE6, 0x4D, 0x4F},
-	   {0xE6, 0xCF, 0x8D},
-	   {0xE5, 0xAD, 0x0E},
-	   {0xE7, 0x33, 0xD7},
-	   {0xE6, 0x9D, 0x91},
-	   {0xE6, 0x1B, 0x33},
-	   {0xE6, 0xE3, 0xA5},
-	   {0xE5, 0xC1, 0x16},
-	   {0xE7, 0x15, 0xC2},
-	   {0xE5, 0xF3, 0x33},
-	   {0xE6, 0x6B, 0x64},
-	   {0xE7, 0x51, 0xDB},
-	   {0xE6, 0x39, 0x58}
+	918075989, 921050964, 924496948, 921991943, 919328979, 925436951,
+	923085999, 920112000, 923712952, 921520996, 918546997, 922617981,
+	924963989, 920581970, 918859985, 922304993, 924028992, 919642944,
+	925750000, 921365967, 918389954, 922774963, 924653992, 920268982,
+	925591980, 919174988, 921833984, 923400940, 925122986, 918233948,
+	920738953, 924182983, 922146973, 919487000, 922931946, 925905945,
+	923869995, 919955994, 921207947, 923242981, 918703979, 924809998,
+	922461975, 920424988, 923556946, 919016968, 924339966, 919799988,
+	921677979, 925278992, 920895996
 	};
 
-static const __attribute__((progmem)) FRF_ITEM FRF_EU[FREQ_TABLE_LENGTH_EU] =
+static constexpr uint32_t HZ_EU[] =
 	{
-	  {0xD9, 0x04, 0x45},
-	  {0xD9, 0x13, 0x04},
-	  {0xD9, 0x21, 0xC2},
-	  {0xD9, 0x0B, 0xA4},
-	  {0xD9, 0x1A, 0x63}
+	868066711, 868297119, 868527466, 868181885, 868412292
 	};
 
-static const __attribute__((progmem)) FRF_ITEM FRF_NZ[FREQ_TABLE_LENGTH_NZ] =
+static constexpr uint32_t HZ_NZ[] =
 	{
-	  {0xE6, 0x45, 0x0E},
-	  {0xE7, 0x43, 0xC7},
-	  {0xE6, 0xF4, 0xAC},
-	  {0xE6, 0x9C, 0xEE},
-	  {0xE7, 0xA4, 0x7B},
-	  {0xE6, 0xC0, 0x31},
-	  {0xE7, 0xD0, 0x52},
-	  {0xE7, 0x20, 0x93},
-	  {0xE6, 0x68, 0x31},
-	  {0xE7, 0x67, 0x0A},
-	  {0xE6, 0xDA, 0x5E},
-	  {0xE7, 0xE1, 0xEC},
-	  {0xE7, 0x8A, 0x0C},
-	  {0xE6, 0x82, 0xA0},
-	  {0xE7, 0x0F, 0x1B},
-	  {0xE7, 0xBE, 0xE9},
-	  {0xE6, 0xB7, 0x3B},
-	  {0xE7, 0x4C, 0x6A},
-	  {0xE7, 0xFC, 0x5A},
-	  {0xE6, 0x4D, 0xF4},
-	  {0xE7, 0x92, 0xD1},
-	  {0xE6, 0xEB, 0xF8},
-	  {0xE6, 0x94, 0x39},
-	  {0xE7, 0xEA, 0xC1},
-	  {0xE7, 0x29, 0x79},
-	  {0xE6, 0x5F, 0x7D},
-	  {0xE7, 0x5E, 0x35},
-	  {0xE6, 0xC8, 0xC5},
-	  {0xE7, 0xB6, 0x25},
-	  {0xE6, 0xA5, 0xB2},
-	  {0xE6, 0xFD, 0x81},
-	  {0xE7, 0x6F, 0xCF},
-	  {0xE6, 0x79, 0xCB},
-	  {0xE7, 0x9B, 0xB6},
-	  {0xE7, 0x32, 0x2D},
-	  {0xE7, 0xC7, 0x7D},
-	  {0xE6, 0x8B, 0x54},
-	  {0xE7, 0x81, 0x37},
-	  {0xE6, 0xD1, 0x89},
-	  {0xE7, 0x55, 0x60},
-	  {0xE7, 0xD9, 0x17},
-	  {0xE6, 0x56, 0xA8},
-	  {0xE7, 0x06, 0x35},
-	  {0xE7, 0xAD, 0x2F},
-	  {0xE6, 0xAE, 0x77},
-	  {0xE7, 0x3B, 0x12},
-	  {0xE7, 0xF3, 0x85},
-	  {0xE6, 0x71, 0x06},
-	  {0xE7, 0x17, 0xCF},
-	  {0xE6, 0xE3, 0x12},
-	  {0xE7, 0x78, 0xA4}
+	921078979, 925059021, 923822998, 922452026, 926570007, 923002991,
+	927255005, 924508972, 921627991, 925609985, 923411987, 927530029,
+	926156982, 922041016, 924236023, 926982971, 922862976, 925193970,
+	927942993, 921218018, 926294006, 923687012, 922315979, 927668030,
+	924648010, 921492004, 925471985, 923137024, 926846008, 922588989,
+	923960999, 925747009, 921903015, 926432983, 924783997, 927117004,
+	922177002, 926018982, 923273987, 925333984, 927392029, 921354004,
+	924096985, 926705994, 922726013, 924922974, 927804993, 921765991,
+	924372009, 923547974, 925885010
 	};
 
-static const FRF_ITEM *bandTab[4] = {
-  FRF_US,
-  FRF_AU,
-  FRF_EU,
-  FRF_NZ
+	// FRF register value for a frequency, rounded to the nearest Fstep
+constexpr uint32_t frfOf(uint32_t hz) { return (uint32_t) ((((uint64_t) hz << 19) + 16000000) / 32000000); }
+
+	// whether every frequency in a table is within lo..hi
+template <unsigned N>
+constexpr bool hzInRange(const uint32_t (&hz)[N], uint32_t lo, uint32_t hi, unsigned i = 0) {
+	return i == N || (hz[i] >= lo && hz[i] <= hi && hzInRange(hz, lo, hi, i + 1));
+	}
+
+static_assert(sizeof(HZ_US) / sizeof(HZ_US[0]) == FREQ_TABLE_LENGTH_US, "HZ_US must have FREQ_TABLE_LENGTH_US channels");
+static_assert(sizeof(HZ_AU) / sizeof(HZ_AU[0]) == FREQ_TABLE_LENGTH_AU, "HZ_AU must have FREQ_TABLE_LENGTH_AU channels");
+static_assert(sizeof(HZ_EU) / sizeof(HZ_EU[0]) == FREQ_TABLE_LENGTH_EU, "HZ_EU must have FREQ_TABLE_LENGTH_EU channels");
+static_assert(sizeof(HZ_NZ) / sizeof(HZ_NZ[0]) == FREQ_TABLE_LENGTH_NZ, "HZ_NZ must have FREQ_TABLE_LENGTH_NZ channels");
+static_assert(hzInRange(HZ_US, 902000000, 928000000), "US channels must be within 902-928 MHz");
+static_assert(hzInRange(HZ_AU, 915000000, 928000000), "AU channels must be within 915-928 MHz");
+static_assert(hzInRange(HZ_EU, 863000000, 870000000), "EU channels must be within 863-870 MHz");
+static_assert(hzInRange(HZ_NZ, 921000000, 929000000), "NZ channels must be within 921-929 MHz");
+
+	// Turning a table of frequencies into one of FRF values: FrfIndexer<N>::type lists
+	// 0..N-1 for frfTable() to expand
+template <unsigned... I> struct FrfIndices {};
+template <unsigned N, unsigned... I> struct FrfIndexer : FrfIndexer<N - 1, N - 1, I...> {};
+template <unsigned... I> struct FrfIndexer<0, I...> { typedef FrfIndices<I...> type; };
+
+template <unsigned N> struct FrfTable { uint32_t frf[N]; };
+
+template <unsigned N, unsigned... I>
+constexpr FrfTable<N> frfTable(const uint32_t (&hz)[N], FrfIndices<I...>) { return {{ frfOf(hz[I])... }}; }
+
+template <unsigned N>
+constexpr FrfTable<N> frfTable(const uint32_t (&hz)[N]) { return frfTable(hz, typename FrfIndexer<N>::type()); }
+
+static constexpr FrfTable<FREQ_TABLE_LENGTH_US> FRF_US PROGMEM = frfTable(HZ_US);
+static constexpr FrfTable<FREQ_TABLE_LENGTH_AU> FRF_AU PROGMEM = frfTable(HZ_AU);
+static constexpr FrfTable<FREQ_TABLE_LENGTH_EU> FRF_EU PROGMEM = frfTable(HZ_EU);
+static constexpr FrfTable<FREQ_TABLE_LENGTH_NZ> FRF_NZ PROGMEM = frfTable(HZ_NZ);
+
+static const uint32_t *const bandTab[4] = {
+  FRF_US.frf,
+  FRF_AU.frf,
+  FRF_EU.frf,
+  FRF_NZ.frf
 	};
 
 static const uint8_t bandTabLengths[4] = {
@@ -209,4 +121,38 @@ static const uint8_t bandTabLengths[4] = {
   FREQ_TABLE_LENGTH_NZ
 	};
 
-#endif  // DAVISRFM_h
+	// Hop table lookups for DavisRFM69Radio<Band...>. For a band fixed at compile time
+	// they ignore the band argument and fold into constants; FREQ_BAND_ANY looks it up.
+template <uint8_t Band> struct BandTable;
+
+template <> struct BandTable<FREQ_BAND_ANY> {
+	enum { MAX_LENGTH = FREQ_TABLE_LENGTH_US };		// the longest
+	static uint8_t length(uint8_t band) { return bandTabLengths[band]; }
+	static uint32_t frf(uint8_t band, uint8_t channel) { return pgm_read_dword(&bandTab[band][channel]); }
+	};
+
+template <> struct BandTable<FREQ_BAND_US> {
+	enum { MAX_LENGTH = FREQ_TABLE_LENGTH_US };
+	static uint8_t length(uint8_t) { return MAX_LENGTH; }
+	static uint32_t frf(uint8_t, uint8_t channel) { return pgm_read_dword(&FRF_US.frf[channel]); }
+	};
+
+template <> struct BandTable<FREQ_BAND_AU> {
+	enum { MAX_LENGTH = FREQ_TABLE_LENGTH_AU };
+	static uint8_t length(uint8_t) { return MAX_LENGTH; }
+	static uint32_t frf(uint8_t, uint8_t channel) { return pgm_read_dword(&FRF_AU.frf[channel]); }
+	};
+
+template <> struct BandTable<FREQ_BAND_EU> {
+	enum { MAX_LENGTH = FREQ_TABLE_LENGTH_EU };
+	static uint8_t length(uint8_t) { return MAX_LENGTH; }
+	static uint32_t frf(uint8_t, uint8_t channel) { return pgm_read_dword(&FRF_EU.frf[channel]); }
+	};
+
+template <> struct BandTable<FREQ_BAND_NZ> {
+	enum { MAX_LENGTH = FREQ_TABLE_LENGTH_NZ };
+	static uint8_t length(uint8_t) { return MAX_LENGTH; }
+	static uint32_t frf(uint8_t, uint8_t channel) { return pgm_read_dword(&FRF_NZ.frf[channel]); }
+	};
+
+#endif  // DAVISRFM69_FREQUENCIES_h
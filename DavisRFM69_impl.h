@@ -0,0 +1,900 @@
+// DavisRFM69Radio member definitions, included at the end of DavisRFM69.h: a template's
+// code has to be seen where it is instantiated, so the sketch compiles the driver for the
+// band, number of stations and queue depth it asks for. The register access and interrupt
+// handling underneath (DavisRFM69Base) are in DavisRFM69.cpp.
+
+#ifndef DAVISRFM69_IMPL_h
+#define DAVISRFM69_IMPL_h
+
+#include "RFM69registers.h"
+#ifdef DAVISRFM69_TIMER_TUNE
+#include "DavisRFM69_timer.h"
+#endif
+#ifdef DAVISRFM69_DEBUG
+#include "DavisRFM69_trace.h"
+#define TRACE(event, a, b, c) traceEvent(event, a, b, c)
+#else
+#define TRACE(event, a, b, c)
+#endif
+
+int freeMemory();
+
+	// The stations to listen for, copied in; more than MaxStations are left out. Call
+	// before initialize().
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::setStations(const Station *config, byte count) {
+	if (count > MaxStations) count = MaxStations;
+	memcpy(stations, config, count * sizeof(Station));
+	numStations = count;
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::initialize(byte freqBand) {
+	begin();
+	mode = SM_IDLE;
+	band = Band == FREQ_BAND_ANY ? freqBand : Band;		// built for one band, whatever was asked for
+	setChannel(0);
+	for (byte i = 0; i < numStations; i++) {
+		stations[i].channel = 0;
+		stations[i].lastRx = 0;
+		stations[i].interval = 0;
+		stations[i].lostPackets = 0;
+		stations[i].sacrificed = 0;
+		stations[i].lastRx = 0;
+		stations[i].lastSeen = 0;
+		stations[i].packets = 0;
+		stations[i].syncBegan = 0;
+		stations[i].rxOnTime = 0;
+		stations[i].phaseHint = false;
+		stations[i].freqOffset = 0;
+		stations[i].freqSamples = 0;
+		resetWindow(i);
+		}
+	memset(chanOffset, 0, sizeof(chanOffset));
+	stationsFound = 0;
+	searchChannel = complements ? Hops::length(band) / 2 : 0;
+	searchBegan = 0;
+	wakeLen = 0;
+	memset(wakePos, WAKE_NONE, sizeof(wakePos));
+	}
+
+	/**
+	 * Called by the main arduino loop, used when not using a timer (handleTimerInt)
+	 * this will check for lost packets and tune the radio to the proper channel
+	 * hopefully at the proper time. Added by AMM.
+	 */
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::loop() {
+#ifdef DAVISRFM69_TIMER_TUNE
+	// the packets handled here go on to partnerHeard(), which changes the other radio of a
+	// pair as much as its own loop() does: its timer tune-in waits for this one too
+	inLoop = true;
+	if (partner != NULL) partner->inLoop = true;
+	service();
+	loopDone();
+	if (partner != NULL) partner->loopDone();
+#else
+	service();
+#endif
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::service() {
+	// check what the ISR captured since the last call
+	processRaw();
+
+#ifdef DAVISRFM69_DEBUG
+	// send out the trace, as far as Serial takes it without blocking
+	traceFlush();
+#endif
+
+	// first see if we have tuned into receive a station previously and failed to actually receive a packet
+	if (mode == SM_RECEIVING) {
+		// There's a bit of a race here as if the packet Interrupt triggers between the above if()
+		// and the below if() it may update curStation to be the next station
+		// however the timing recvBegan will still be the previous loop so this will believe
+		// the packet was lost(until the timing updates later in this function)
+		// so we re-check mode one more time and if the receive packet interrupt cleared it
+		// then we hopefully won't flag a wrong packet as missed
+		// provided the compiler doesn't re-order the checks in the if statement
+
+	  // packet was lost
+		if (difftime(micros(), stations[curStation].recvBegan) > recvWindow
+		&& mode == SM_RECEIVING ) {
+			TRACE(TR_MISSED, stations[curStation].id, stations[curStation].channel, 0);
+			stations[curStation].rxOnTime += difftime(micros(), stations[curStation].recvBegan);
+			lostPackets++;
+			skipPacket(curStation);
+			
+
+			// lost a station
+			if (stations[curStation].lostPackets > RESYNC_THRESHOLD) {
+				TRACE(TR_LOST, stations[curStation].id, 0, 0);
+				stations[curStation].lostPackets = 0;
+				stations[curStation].interval = 0;
+#ifndef DAVISRFM69_FIXED_DISCOVERY
+				stations[curStation].phaseHint = true;
+#endif
+				resetWindow(curStation);
+
+				lostStations++;
+				stationsFound--;
+				}
+			schedule(curStation);
+
+			curStation = -1;
+			mode = SM_IDLE;
+			setMode(RF69_MODE_STANDBY);
+		}
+		else {
+	   // waiting to receive and it hasn't timed out yet.
+	   // do nothing.
+			return;
+			}
+		}
+
+		// next check for the station that's about to transmit, if any, and tune in.
+		// Stations are in wakeHeap once discovered, the earliest on top; it is left
+		// there and rescheduled when its packet arrives or is given up on. The radio
+		// that has the timer (DAVISRFM69_TIMER_TUNE) is tuned in from its interrupt.
+	if (!timerTuned()) {
+		noInterrupts();
+		bool due = wakeLen > 0 && (int32_t) (micros() - wakeHeap[0].at) > 0;
+		byte i = wakeHeap[0].station;
+		interrupts();
+#ifdef DAVISRFM69_DEBUG_VERBOSE
+		if (wakeLen > 0) TRACE(TR_TUNE_CHECK, stations[i].id, stations[i].channel,
+			difftime(stations[i].lastRx + stations[i].interval, micros()));
+#endif
+		if (due) {
+			i = arbitrate(i);
+			if (i != WAKE_NONE) tuneIn(i);
+			return;
+			}
+		}
+
+		// if no transmitter is about to transmit, listen for any
+		// station that we are not synchonized with
+	bool all_sync = search();
+
+	if (all_sync) {
+		mode = SM_SYNCHRONIZED;
+
+		// if we got here, no stations are about to TX and all stations are in sync,
+		// we can disable our radio to save power.
+		if (_mode != RF69_MODE_SLEEP) {
+			TRACE(TR_SLEEP, 0, 0, 0);
+			setMode(RF69_MODE_SLEEP);
+			}
+		}
+	}
+
+#ifdef DAVISRFM69_FIXED_DISCOVERY
+	// If there are any stations not synchronized, turn on the receiver on the channel of
+	// the first one and hope we get lucky. Returns true when all are synchronized.
+template <byte Band, byte MaxStations, byte FifoDepth>
+bool DavisRFM69Radio<Band, MaxStations, FifoDepth>::search() {
+	byte i;
+	bool all_sync = true;
+	for (i = 0; i < numStations; i++) {
+	  // unknown stations will have interval of zero, the radio interrupt will
+	  // fill this in if we receive a packet from the given station.
+		if (stations[i].interval == 0) {
+			mode = SM_SEARCHING;
+			all_sync = false;
+			if (stations[i].syncBegan == 0) {
+				// we have never tried to sync to this station
+				TRACE(TR_SYNC, stations[i].id, stations[i].channel, 0);
+				stations[i].syncBegan = micros();
+				stations[i].progress = 0;
+				setChannel(stations[i].channel);
+				}
+			else if (difftime(micros(), stations[i].syncBegan) > DISCOVERY_STEP) {
+			   // we tried and failed to sync, try the next channel
+
+				stations[i].channel = nextChannel(stations[i].channel);
+				TRACE(TR_SYNC_FAIL, stations[i].id, stations[i].channel, 0);
+				stations[i].syncBegan = micros();
+				stations[i].progress = 0;
+				setChannel(stations[i].channel);
+				}
+			else {
+				if (CHANNEL != stations[i].channel) setChannel(stations[i].channel);
+			 // we're waiting to hear from this station, don't tune away!
+			 setMode(RF69_MODE_RX);
+
+#ifdef DAVISRFM69_DEBUG
+				byte p = difftime(micros(), stations[i].syncBegan) / (DISCOVERY_STEP / 100);
+
+				if (stations[i].progress != p) {
+					TRACE(TR_PROGRESS, p, 0, freeMemory());		// free memory added by JF
+					stations[i].progress = p;
+					}
+#endif
+				break;
+				}
+			}
+		}
+	return all_sync;
+	}
+
+#else
+	// Listen for the stations not synchronized, if any; true when all are. Lost stations
+	// whose timing is still known get the radio while a window around their next packet is
+	// open. The others share one channel, parked on until the slowest of them must have
+	// come by, so a packet from one leaves the search going on for the rest undisturbed.
+template <byte Band, byte MaxStations, byte FifoDepth>
+bool DavisRFM69Radio<Band, MaxStations, FifoDepth>::search() {
+	bool all_sync = true;
+	int cold = -1;
+	for (byte i = 0; i < numStations; i++) {
+		if (stations[i].interval != 0) continue;
+		all_sync = false;
+		mode = SM_SEARCHING;
+		if (stations[i].phaseHint && reacquire(i)) {
+			if (CHANNEL != stations[i].channel) setChannel(stations[i].channel, freqCorrection(i, stations[i].channel));
+			setMode(RF69_MODE_RX);
+			return false;
+			}
+		if (!stations[i].phaseHint && cold < 0) cold = i;
+		}
+	if (all_sync) {
+		searchBegan = 0;
+		return true;
+		}
+
+	if (cold < 0) {
+		// only lost stations, and none of them due
+		searchBegan = 0;
+		setMode(RF69_MODE_STANDBY);
+		return false;
+		}
+
+	uint32_t now = micros();
+	uint32_t dwell = discoveryDwell();
+	if (searchBegan == 0) {
+		TRACE(TR_SYNC, stations[cold].id, searchChannel, dwell);
+		searchBegan = now;
+		searchProgress = 0;
+		}
+	else if (difftime(now, searchBegan) > dwell) {
+		// a whole hop cycle without a packet: something is in the way on this channel
+		searchChannel = nextChannel(searchChannel);
+		TRACE(TR_SYNC_FAIL, stations[cold].id, searchChannel, dwell);
+		searchBegan = now;
+		searchProgress = 0;
+		}
+	if (CHANNEL != searchChannel) setChannel(searchChannel);
+	setMode(RF69_MODE_RX);
+
+#ifdef DAVISRFM69_DEBUG
+	byte p = difftime(now, searchBegan) / (dwell / 100);
+	if (searchProgress != p) {
+		TRACE(TR_PROGRESS, p, 0, freeMemory());
+		searchProgress = p;
+		}
+#endif
+	return false;
+	}
+#endif
+
+	// How long discovery parks on a channel: every channel of the band goes by once per
+	// hop cycle, so a whole cycle of the slowest station searched for, and a little more
+	// for the packet that may straddle the ends of the dwell
+template <byte Band, byte MaxStations, byte FifoDepth>
+uint32_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::discoveryDwell() {
+	uint32_t slowest = 0;
+	for (byte i = 0; i < numStations; i++)
+		if (stations[i].interval == 0 && nominalInterval(stations[i].id) > slowest)
+			slowest = nominalInterval(stations[i].id);
+	return (Hops::length(band) + DISCOVERY_GUARD_HOPS) * slowest;
+	}
+
+	// For a lost station, whether to listen for it now: its packets still come every
+	// intervalQ8 and hop as before, but may have moved from the prediction by as much as
+	// both clocks could drift since it was last heard. Once a window around a predicted
+	// packet is over, wait for the next one that can be listened to whole. Gives up on the
+	// timing (the station gets searched for from scratch) when that gets too long ago.
+template <byte Band, byte MaxStations, byte FifoDepth>
+bool DavisRFM69Radio<Band, MaxStations, FifoDepth>::reacquire(byte st) {
+	Station &s = stations[st];
+	uint32_t now = micros();
+	uint32_t since = now - s.lastSeen;
+	uint32_t spread = since / (1000000L / (2 * DRIFT_MAX_PPM));
+	uint32_t interval = s.intervalQ8 >> 8;
+	if (since > REACQUIRE_USEC || 2 * spread + interval > discoveryDwell()) {
+		s.phaseHint = false;
+		return false;
+		}
+	uint32_t lead = spread + TUNEIN_USEC;
+	if ((int32_t) (now - (s.lastRx + interval + spread + LATE_PACKET_THRESH)) > 0) {
+		do advancePhase(st);
+		while ((int32_t) (now - (s.lastRx + interval - lead)) > 0);
+		TRACE(TR_REACQUIRE, s.id, s.channel, spread);
+		}
+	return (int32_t) (now - (s.lastRx + interval - lead)) >= 0;
+	}
+
+	// Check a captured packet against the stations and update their timing. Runs from
+	// loop() via processRaw(), or straight from the ISR with DAVISRFM69_RX_IN_ISR.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::handleRadioInt(RawPacket *rp) {
+	uint32_t lastRx = rp->time;
+	byte *DATA = rp->packet;
+
+	// repeater packets checksum bytes (0..5) and (8..9), the ISR tried both
+	bool repeaterCrcTried = rp->crc == RAW_CRC_REPEATER;
+
+	// packet passed crc?
+	if (rp->crc != RAW_CRC_BAD) {
+
+	  // station id is byte 0:0-2
+		byte id = DATA[0] & 7;
+		int stIx = findStation(id);
+
+		// if we have no station cofigured for this id (at all; can still be be !active), ignore the packet
+		// OR packet passed the repeater crc check, but no repeater is set for the station
+		// OR packet passed the normal crc check, and repeater is set for the station
+		if (stIx < 0
+			|| (repeaterCrcTried && stations[stIx].repeaterId == 0)
+			|| (!repeaterCrcTried && stations[stIx].repeaterId != 0)) {
+			setChannel(rp->channel, rp->freqCorr);
+			return;
+			}
+
+		bool wasSynced = stations[stIx].interval != 0;
+		if (!wasSynced) stationFound(stIx);
+
+		packets++;
+		learnOffset(stIx, rp);
+		if (stations[stIx].active) {
+			stations[stIx].packets++;
+			RadioData *rd = packetFifo.slot();
+			if (rd != NULL) {
+				memcpy(rd->packet, DATA, DAVIS_PACKET_LEN);
+				rd->channel = rp->channel;
+				rd->rssi = rp->rssi;
+				rd->fei = rp->fei + rp->freqCorr;
+				rd->delta = stations[stIx].lastSeen > 0 ? lastRx - stations[stIx].lastSeen : 0;
+				packetFifo.push();
+				}
+			else packetFifo.drop();
+			}
+
+		// the packet we tuned in for: how far off was the prediction?
+		if (mode == SM_RECEIVING && curStation == stIx) {
+			stations[stIx].earlyAmt = difftime(lastRx, stations[stIx].recvBegan);
+			stations[stIx].rxOnTime += stations[stIx].earlyAmt;
+			TRACE(TR_EARLY, stIx, 0, stations[stIx].earlyAmt);
+			adaptWindow(stIx, lastRx - (stations[stIx].lastRx + stations[stIx].interval));
+			}
+		stationHeard(stIx, lastRx, rp->channel, wasSynced);
+
+	// no longer waiting to RX (if we were at all anwyay)
+		mode = SM_IDLE;
+		// standby the radio
+		setMode(RF69_MODE_STANDBY);
+		if (partner != NULL) partner->partnerHeard(stIx, lastRx, rp->channel);
+		}
+	else {
+   // bad CRC, go back to RX on this channel
+		setChannel(rp->channel, rp->freqCorr); // this always has to be done somewhere right after reception, even for ignored/bogus packets
+		}
+	}
+
+	// First packet from a station not synchronized: its timing starts from here
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::stationFound(byte st) {
+	if (stationsFound >= numStations) return;
+	// We don't get signaled till the end of the packet, hopping is from
+	// start to start (4 preamble, 2 sync, 10 data at 19200 symbol/second(bits))
+	// A lost station found again keeps the interval it was tracked at
+	if (!stations[st].phaseHint) stations[st].intervalQ8 = nominalInterval(stations[st].id) << 8;
+	stations[st].interval = (stations[st].intervalQ8 + 128) >> 8;
+	stations[st].phaseHint = false;
+
+	stationsFound++;
+	TRACE(TR_FOUND, st, 0, stations[st].interval);
+	if (lostStations > 0) lostStations--;
+	}
+
+	// A packet from a station was on the air at time on channel: expect the next one an
+	// interval later, on the next channel
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::stationHeard(byte st, uint32_t time, byte channel, bool wasSynced) {
+	if (partner != NULL && heardAlready(st, time)) return;	// the other radio's copy did this
+	if (wasSynced) trackDrift(st, time - stations[st].lastSeen);
+	stations[st].channel = nextChannel(channel);
+	stations[st].lostPackets = 0;
+	stations[st].lastRx = time;
+	stations[st].lastRxQ8 = 0;
+	stations[st].lastSeen = time;
+	schedule(st);
+	}
+
+	// Use the other radio of a pair: the stations' timing follows what either of them
+	// hears, and with complement this one takes the other side of collisions and
+	// searches from the other half of the band. Both must have the same stations.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::pair(DavisRFM69Radio *other, bool complement) {
+	partner = other;
+	complements = complement;
+	}
+
+	// Whether the packet of station st on the air at time has already been accounted for
+template <byte Band, byte MaxStations, byte FifoDepth>
+bool DavisRFM69Radio<Band, MaxStations, FifoDepth>::heardAlready(byte st, uint32_t time) {
+	return stations[st].interval != 0 && difftime(time, stations[st].lastSeen) < stations[st].interval / 2;
+	}
+
+	// A packet from station st the partner radio got. If we were listening for it and
+	// didn't get it, that isn't a miss; if we did, our own copy is on its way and does
+	// the rest. Carrier offset and window are only learned from our own packets.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::partnerHeard(byte st, uint32_t time, byte channel) {
+	if (st >= numStations || capturing() || heardAlready(st, time)) return;
+	bool wasSynced = stations[st].interval != 0;
+	if (!wasSynced) stationFound(st);
+	if (mode == SM_RECEIVING && curStation == st) {
+		stations[st].rxOnTime += difftime(micros(), stations[st].recvBegan);
+		mode = SM_IDLE;
+		setMode(RF69_MODE_STANDBY);
+		}
+	stationHeard(st, time, channel, wasSynced);
+	}
+
+	// Bottom half: handle the packets the ISR captured, oldest first
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::processRaw() {
+	RawPacket *rp;
+	while ((rp = rawFifo.peek()) != NULL) {
+		handleRadioInt(rp);
+		rawFifo.pop();
+		}
+	}
+
+	// Calculate the next hop of the specified channel
+template <byte Band, byte MaxStations, byte FifoDepth>
+byte DavisRFM69Radio<Band, MaxStations, FifoDepth>::nextChannel(byte channel) {
+	// a compare rather than %: the M0+ has no divide instruction
+	if (++channel >= Hops::length(band)) channel = 0;
+	return channel;
+	}
+
+	// Microseconds until loop() has anything to do, unless the radio interrupts first. The
+	// sketch may sleep this long (WFI) between calls; 0 means keep polling.
+template <byte Band, byte MaxStations, byte FifoDepth>
+uint32_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::idleTime() {
+	if (!rawFifo.empty()) return 0;
+	uint32_t now = micros();
+	int32_t left;
+	if (mode == SM_RECEIVING) {
+		Station &st = stations[curStation];
+		left = st.recvBegan + recvWindow - now;
+		}
+	else if (mode == SM_SEARCHING || wakeLen == 0) return 0;
+	else left = wakeHeap[0].at - now;
+	return left > 0 ? left : 0;
+	}
+
+	// When to tune in for a station's next packet: its window's lead before the packet is due to end
+template <byte Band, byte MaxStations, byte FifoDepth>
+uint32_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::wakeTime(byte st) {
+	return stations[st].lastRx + stations[st].interval - windowLead(st);
+	}
+
+	// The window around the next packet, widened for every packet missed in a row. The
+	// fixed window doubles, triples... as the driver always did; the adaptive one grows
+	// by the timing spread it has seen, plus MISS_WIDEN_USEC for drift it hasn't.
+template <byte Band, byte MaxStations, byte FifoDepth>
+uint32_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::windowLead(byte st) {
+	Station &s = stations[st];
+#ifdef DAVISRFM69_FIXED_WINDOW
+	return (1 + s.lostPackets) * (uint32_t) s.tuneLead;
+#else
+	return s.tuneLead + s.lostPackets * (s.arrivalDev + MISS_WIDEN_USEC);
+#endif
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+uint32_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::windowLate(byte st) {
+	Station &s = stations[st];
+#ifdef DAVISRFM69_FIXED_WINDOW
+	return (1 + s.lostPackets) * (uint32_t) s.lateThresh;
+#else
+	return s.lateThresh + s.lostPackets * (s.arrivalDev + MISS_WIDEN_USEC);
+#endif
+	}
+
+	// Give up on a station's next packet: expect the one after, an interval later on the
+	// next channel. The fraction of the estimated interval is carried, so a long run of
+	// misses doesn't add up rounding errors.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::skipPacket(byte st) {
+	stations[st].lostPackets++;
+	advancePhase(st);
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::advancePhase(byte st) {
+	Station &s = stations[st];
+	uint32_t step = s.intervalQ8 + s.lastRxQ8;
+	s.lastRx += step >> 8;
+	s.lastRxQ8 = step & 0xff;
+	s.channel = nextChannel(s.channel);
+	}
+
+	// Frequency-locked loop on the station's packet interval: compare the time since the
+	// last packet seen with the whole number of intervals it must have been, and move the
+	// estimate part of the way there. Spans over missed packets average out more timing
+	// noise, so they are trusted more.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::trackDrift(byte st, uint32_t sinceSeen) {
+#ifndef DAVISRFM69_FIXED_INTERVAL
+	Station &s = stations[st];
+	uint32_t n = (sinceSeen + s.interval / 2) / s.interval;
+	if (n == 0 || n > RESYNC_THRESHOLD + 1) return;
+	int32_t off = sinceSeen - n * s.interval;
+	if (off <= -TUNEIN_USEC || off >= TUNEIN_USEC) return;	// not the packet we think it is
+
+	int32_t err = (int32_t) ((((uint64_t) sinceSeen << 8) + n / 2) / n - s.intervalQ8);
+	byte gain = n >= 4 ? 1 : n >= 2 ? 2 : 3;				// 1/2, 1/4 or 1/8 of the error
+	s.intervalQ8 += err >> gain;
+
+	uint32_t nominal = nominalInterval(s.id) << 8;
+	uint32_t limit = nominal / 1000000 * DRIFT_MAX_PPM;
+	if (s.intervalQ8 > nominal + limit) s.intervalQ8 = nominal + limit;
+	if (s.intervalQ8 < nominal - limit) s.intervalQ8 = nominal - limit;
+	s.interval = (s.intervalQ8 + 128) >> 8;
+#endif
+	}
+
+	// Back to the full window, for a station not (or no longer) synchronized
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::resetWindow(byte st) {
+	stations[st].arrivalBias = 0;
+	stations[st].arrivalDev = 0;
+	stations[st].tuneLag = 0;
+	stations[st].windowSamples = 0;
+	stations[st].tuneLead = TUNEIN_USEC;
+	stations[st].lateThresh = LATE_PACKET_THRESH;
+	}
+
+	// Fold a packet's arrival error (actual minus predicted end of packet) into the
+	// station's timing statistics. Misses widen the window through windowLead/Late().
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::adaptWindow(byte st, int32_t err) {
+	Station &s = stations[st];
+	if (err <= -TUNEIN_USEC || err >= TUNEIN_USEC) return;
+	// mean and mean deviation as in TCP's RTT estimator (RFC 6298), in fixed point
+	s.arrivalBias += err - (s.arrivalBias >> 3);
+	int32_t dev = err - (s.arrivalBias >> 3);
+	if (dev < 0) dev = -dev;
+	s.arrivalDev += dev - (s.arrivalDev >> 2);
+	if (s.windowSamples < WINDOW_WARMUP) {
+		s.windowSamples++;
+		return;
+		}
+	setWindow(st);
+	}
+
+	// Lead: the whole packet on the air, the guard, how late we tend to tune in, and how
+	// early the packet may come. Late threshold: the guard and how late it may come.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::setWindow(byte st) {
+#ifndef DAVISRFM69_FIXED_WINDOW
+	Station &s = stations[st];
+	int32_t bias = s.arrivalBias >> 3;
+	int32_t spread = s.arrivalDev;			// 4 deviations
+	int32_t early = spread - bias;
+	int32_t late = spread + bias;
+	int32_t lead = PACKET_AIRTIME_USEC + WINDOW_GUARD_USEC + s.tuneLag + (early > 0 ? early : 0);
+	late = WINDOW_GUARD_USEC + (late > 0 ? late : 0);
+	s.tuneLead = lead < TUNEIN_USEC ? lead : TUNEIN_USEC;
+	s.lateThresh = late < LATE_PACKET_THRESH ? late : LATE_PACKET_THRESH;
+#endif
+	}
+
+	// The carrier offset to tune a station's channel with: what its packets showed overall,
+	// and on that channel in particular
+template <byte Band, byte MaxStations, byte FifoDepth>
+int16_t DavisRFM69Radio<Band, MaxStations, FifoDepth>::freqCorrection(byte st, byte channel) {
+#ifdef DAVISRFM69_FIXED_FREQ
+	return 0;
+#else
+	if (st >= MaxStations) return 0;
+	if (channel >= Hops::MAX_LENGTH) return stations[st].freqOffset;
+	return stations[st].freqOffset + chanOffset[st][channel];
+#endif
+	}
+
+	// Fold a packet's carrier offset (the FEI, measured from where the radio was tuned, plus
+	// that correction) into the station's. The overall offset follows the station's crystal;
+	// what is left on a channel is averaged over its visits, once a hop cycle.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::learnOffset(byte st, RawPacket *rp) {
+#ifndef DAVISRFM69_FIXED_FREQ
+	if (st >= MaxStations) return;
+	Station &s = stations[st];
+	int16_t off = rp->fei + rp->freqCorr;
+	if (s.freqSamples == 0) s.freqOffset = off;
+	else s.freqOffset += (off - s.freqOffset) / 4;
+	if (s.freqSamples < 255) s.freqSamples++;
+	if (rp->channel >= Hops::MAX_LENGTH) return;
+	int16_t c = (chanOffset[st][rp->channel] + off - s.freqOffset) / 2;
+	chanOffset[st][rp->channel] = c > 127 ? 127 : c < -128 ? -128 : c;
+#endif
+	}
+
+	// Put the radio on the channel a station is about to transmit on
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::tuneIn(byte st) {
+	TRACE(TR_TUNE, stations[st].id, stations[st].channel,
+		difftime(stations[st].lastRx + stations[st].interval, micros()));
+	stations[st].recvBegan = micros();
+
+	// how late we got here, to leave room for it in the window
+	int32_t lag = stations[st].recvBegan - wakeTime(st);
+	if (lag < 0) lag = 0;
+	if (lag > TUNEIN_USEC) lag = TUNEIN_USEC;
+	if ((uint32_t) lag > stations[st].tuneLag) stations[st].tuneLag = lag;
+	else stations[st].tuneLag -= (stations[st].tuneLag - lag) >> 4;
+	setChannel(stations[st].channel, freqCorrection(st, stations[st].channel));
+
+	// we are now set to receive from this station.
+	mode = SM_RECEIVING;
+	curStation = st;
+	}
+
+	// About to tune in to st, on top of wakeHeap: look at the station due after it. If its
+	// window opens before st's closes, and its packet comes after st's, st's window may be
+	// cut short in time for it; if it comes before, it is listened for first. If the packets
+	// overlap, the policy picks one and the other one's packet is given up on now. Sets
+	// recvWindow, returns the station to tune in to, or WAKE_NONE if that was st's packet.
+template <byte Band, byte MaxStations, byte FifoDepth>
+byte DavisRFM69Radio<Band, MaxStations, FifoDepth>::arbitrate(byte st) {
+	recvWindow = windowLead(st) + windowLate(st);
+#if DAVISRFM69_COLLISION_POLICY != COLLIDE_NONE
+	for (;;) {
+		byte next = wakeLen > 2 && (int32_t) (wakeHeap[2].at - wakeHeap[1].at) < 0 ? 2 : 1;
+		if (next >= wakeLen) break;
+		uint32_t now = micros();
+		if ((int32_t) (now + recvWindow - wakeHeap[next].at) <= 0) break;
+
+		byte other = wakeHeap[next].station;
+		uint32_t due = stations[st].lastRx + stations[st].interval;
+		int32_t apart = stations[other].lastRx + stations[other].interval - due;
+		if (apart >= PACKET_AIRTIME_USEC) {
+			// the other packet begins after st's ends: wait for st's no longer than that,
+			// unless that would cut into how late st's packet normally comes
+			int32_t cut = due + apart - PACKET_AIRTIME_USEC - now;
+			if (apart >= PACKET_AIRTIME_USEC + (int32_t) stations[st].lateThresh && cut < (int32_t) recvWindow)
+				recvWindow = cut;
+			break;
+			}
+		if (apart <= -PACKET_AIRTIME_USEC) {
+			// the other packet is over before st's begins: listen for that one first
+			recvWindow = wakeHeap[next].at - now + windowLead(other) + windowLate(other);
+			return other;
+			}
+
+		byte keep = collisionWinner(st, other);
+		if (complements) keep = keep == st ? other : st;	// the partner takes that one
+		byte lose = keep == st ? other : st;
+		TRACE(TR_COLLISION, stations[keep].id, stations[lose].id, apart);
+		stations[lose].sacrificed++;
+		lostPackets++;
+		skipPacket(lose);
+		schedule(lose);
+		if (lose == st) return WAKE_NONE;
+		}
+#endif
+	return st;
+	}
+
+	// Which of two stations whose packets collide to listen for, by DAVISRFM69_COLLISION_POLICY.
+	// Ties go to the one due first. The loss budget is what a station may still miss before it
+	// is lost: one running out of it gets the packet, otherwise the one with more left, the
+	// more reliable of the two lately.
+template <byte Band, byte MaxStations, byte FifoDepth>
+byte DavisRFM69Radio<Band, MaxStations, FifoDepth>::collisionWinner(byte first, byte second) {
+#if DAVISRFM69_COLLISION_POLICY == COLLIDE_PRIORITY
+	byte a = stations[first].priority, b = stations[second].priority;
+#elif DAVISRFM69_COLLISION_POLICY == COLLIDE_ALTERNATE
+	uint32_t a = stations[first].sacrificed, b = stations[second].sacrificed;
+#elif DAVISRFM69_COLLISION_POLICY == COLLIDE_LOSS_BUDGET
+	int32_t a = RESYNC_THRESHOLD - stations[first].lostPackets;
+	int32_t b = RESYNC_THRESHOLD - stations[second].lostPackets;
+	if (a < LOSS_BUDGET_RESERVE || b < LOSS_BUDGET_RESERVE) {
+		a = -a;
+		b = -b;
+		}
+#else
+	byte a = 0, b = 0;
+#endif
+	return b > a ? second : first;
+	}
+
+#ifdef DAVISRFM69_TIMER_TUNE
+	// Timer compare interrupt for the wakeup on top of wakeHeap (DAVISRFM69_TIMER_TUNE)
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::timerTune() {
+	// loop() may be using the radio, or a packet it hasn't looked at yet may be about to
+	// send it to standby: let loop() do the tune-in when it is done. So too while a DMA
+	// FIFO transfer has the bus: select() would wait for it, but the DMA complete
+	// interrupt has this one's priority and can't come in to end it.
+	if (inLoop || !rawFifo.empty() || dmaBusy) {
+		tunePending = true;
+		return;
+		}
+	tunePending = false;
+	tuneDue();
+	}
+
+	// End of a loop() pass: a wakeup that came while we were busy, still inLoop so that the
+	// timer interrupt can't start another at the same time (one it defers meanwhile waits
+	// for the next pass)
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::loopDone() {
+	if (tunePending && rawFifo.empty()) {
+		tunePending = false;
+		tuneDue();
+		}
+	inLoop = false;
+	}
+
+	// Tune in to the station on top of wakeHeap if it is due, else re-arm the timer for it
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::tuneDue() {
+	// whatever ends the current reception reschedules, and so re-arms the timer
+	if (mode == SM_RECEIVING || wakeLen == 0) return;
+	if ((int32_t) (micros() - wakeHeap[0].at) < 0) {
+		tuneTimerArm(wakeHeap[0].at);
+		return;
+		}
+	byte st = arbitrate(wakeHeap[0].station);
+	if (st != WAKE_NONE) tuneIn(st);
+	}
+#endif
+
+	// Update a station's wakeup, from loop() or an ISR. With DAVISRFM69_TIMER_TUNE the
+	// timer follows whatever is now on top of the heap, for the radio that has it.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::schedule(byte st) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	reschedule(st);
+#ifdef DAVISRFM69_TIMER_TUNE
+	if (timerTuned()) {
+		if (wakeLen > 0) tuneTimerArm(wakeHeap[0].at);
+		else tuneTimerCancel();
+		}
+#endif
+	__set_PRIMASK(primask);
+	}
+
+	// (Re)insert a station in wakeHeap for its next expected transmission, less the
+	// tune-in lead. Stations that aren't synchronized (interval 0) are taken out.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::reschedule(byte st) {
+	if (st >= MaxStations) return;
+	if (stations[st].interval == 0) {
+		unschedule(st);
+		return;
+		}
+	uint32_t at = wakeTime(st);
+	byte i = wakePos[st];
+	if (i == WAKE_NONE) {
+		i = wakeLen++;
+		wakeHeap[i].station = st;
+		wakePos[st] = i;
+		}
+	wakeHeap[i].at = at;
+	wakeSiftUp(i);
+	wakeSiftDown(wakePos[st]);
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::unschedule(byte st) {
+	byte i = wakePos[st];
+	if (i == WAKE_NONE) return;
+	wakePos[st] = WAKE_NONE;
+	if (i == --wakeLen) return;
+	wakeHeap[i] = wakeHeap[wakeLen];
+	wakePos[wakeHeap[i].station] = i;
+	wakeSiftUp(i);
+	wakeSiftDown(wakePos[wakeHeap[i].station]);
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::wakeSwap(byte a, byte b) {
+	WakeEntry t = wakeHeap[a];
+	wakeHeap[a] = wakeHeap[b];
+	wakeHeap[b] = t;
+	wakePos[wakeHeap[a].station] = a;
+	wakePos[wakeHeap[b].station] = b;
+	}
+
+	// Times are compared by signed difference, so the heap keeps working across the
+	// micros() wrap: all entries are within a few intervals of each other.
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::wakeSiftUp(byte i) {
+	while (i > 0) {
+		byte parent = (i - 1) / 2;
+		if ((int32_t) (wakeHeap[i].at - wakeHeap[parent].at) >= 0) break;
+		wakeSwap(i, parent);
+		i = parent;
+		}
+	}
+
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::wakeSiftDown(byte i) {
+	for (;;) {
+		byte least = i;
+		byte c = 2 * i + 1;
+		if (c < wakeLen && (int32_t) (wakeHeap[c].at - wakeHeap[least].at) < 0) least = c;
+		if (c + 1 < wakeLen && (int32_t) (wakeHeap[c + 1].at - wakeHeap[least].at) < 0) least = c + 1;
+		if (least == i) break;
+		wakeSwap(i, least);
+		i = least;
+		}
+	}
+
+	// Find station index in stations[] for a station ID (-1 if doesn't exist)
+template <byte Band, byte MaxStations, byte FifoDepth>
+int DavisRFM69Radio<Band, MaxStations, FifoDepth>::findStation(byte id) {
+	for (byte i = 0; i < numStations; i++) {
+		if (stations[i].id == id) return i;
+		}
+	return -1;
+	}
+
+	// Top half, after the packet has been read out: bad packets put the radio straight
+	// back into RX, good ones are queued for processRaw() with the radio in standby
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::rxCaptured(RawPacket *rp) {
+	if (rp->crc == RAW_CRC_BAD) {
+		crcErrors++;
+		TRACE(TR_CRC_ERROR, rp->channel, 0, 0);
+		setChannel(rp->channel, rp->freqCorr);
+		return;
+		}
+#ifdef DAVISRFM69_RX_IN_ISR
+	handleRadioInt(rp);
+#else
+	if (rp == &rawScratch) {
+		rawFifo.drop();
+		TRACE(TR_RAW_DROPPED, rp->channel, 0, 0);
+		setChannel(rp->channel, rp->freqCorr);
+		return;
+		}
+	rawFifo.push();
+#endif
+	}
+
+	// Tune to a channel, offset by a number of Fsteps (61.035 Hz) from the band table
+template <byte Band, byte MaxStations, byte FifoDepth>
+void DavisRFM69Radio<Band, MaxStations, FifoDepth>::setChannel(byte channel, int16_t offset) {
+
+	TRACE(TR_CHANNEL, channel, 0, offset);
+
+	byte op = spiOp;
+	spiOp = SPI_OP_HOP;
+	spiStats[SPI_OP_HOP].calls++;
+
+	CHANNEL = channel;
+	if (CHANNEL >= Hops::length(band)) CHANNEL = 0;
+	freqCorr = offset;
+	// FRFMSB, FRFMID, FRFLSB in one auto-incremented write; the chip applies the new
+	// frequency when the LSB lands
+	uint32_t f = Hops::frf(band, CHANNEL) + offset;
+	byte frf[3] = { (byte) (f >> 16), (byte) (f >> 8), (byte) f };
+	writeBurst(REG_FRFMSB, frf, 3);
+
+	if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)
+		writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+	setMode(RF69_MODE_RX);
+	spiOp = op;
+	}
+
+#endif  // DAVISRFM69_IMPL_h
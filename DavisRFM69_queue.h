@@ -0,0 +1,70 @@
+// Single-producer/single-consumer ring used between DavisRFM69's interrupt handlers,
+// its loop() and the sketch.
+//
+// The producer only ever writes head, the consumer only tail; both run free and are
+// masked into the buffer, so N must be a power of 2 (up to 128) and there is no shared
+// count for the two sides to update. A slot is filled in place between slot() and
+// push(), and read in place between peek() and pop().
+
+#ifndef DAVISRFM69_QUEUE_h
+#define DAVISRFM69_QUEUE_h
+
+#include <stdint.h>
+
+template <typename T, uint8_t N>
+class SpscQueue {
+	static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0, "SpscQueue size must be a power of 2 up to 128");
+
+public:
+	volatile uint32_t dropped;		// entries the producer had no room for
+
+	SpscQueue() : dropped(0), head(0), tail(0) {}
+
+	uint8_t size() const { return (uint8_t) (head - tail); }
+	bool empty() const { return head == tail; }
+	bool full() const { return size() == N; }
+	static uint8_t capacity() { return N; }
+
+		// Producer: the entry to fill next, or NULL when full
+	T *slot() { return full() ? NULL : &buf[head & (N - 1)]; }
+
+		// Producer: publish the entry returned by slot()
+	void push() {
+		__sync_synchronize();	// the entry is written before the consumer can see it
+		head = head + 1;
+		}
+
+		// Producer: copy in v, or count it as dropped
+	bool push(const T &v) {
+		T *e = slot();
+		if (e == NULL) {
+			drop();
+			return false;
+			}
+		*e = v;
+		push();
+		return true;
+		}
+
+	void drop() { dropped = dropped + 1; }
+
+		// Consumer: the oldest entry, or NULL when empty
+	T *peek() {
+		if (empty()) return NULL;
+		__sync_synchronize();	// and read after seeing it published
+		return &buf[tail & (N - 1)];
+		}
+
+		// Consumer: release the entry returned by peek()
+	void pop() {
+		__sync_synchronize();	// done reading the entry before the producer may reuse it
+		tail = tail + 1;
+		}
+
+private:
+	T buf[N];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	};
+
+#endif  // DAVISRFM69_QUEUE_h
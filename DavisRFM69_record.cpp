@@ -0,0 +1,97 @@
+// Binary weather record framing for the sketch's output, see DavisRFM69_record.h.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_decode.h"
+#include "DavisRFM69_record.h"
+
+static void fillRecord(WxRecord &r, const RadioData &rd, uint32_t packets, uint32_t lostPackets, const WxData &wx) {
+	r.version = WXREC_VERSION;
+	r.station = rd.packet[0] & 0x7;
+	r.type = rd.packet[0] >> 4;
+	r.flags = rd.packet[0] & 0x8 ? WXREC_BATT_LOW : 0;
+	r.rssi = rd.rssi;
+	r.packets = packets;
+	r.lostPackets = lostPackets;
+	r.rain = wx.rain;
+	r.rainrate = wx.rainrate;
+	r.rh = wx.rh;
+	r.soilleaf = wx.soilleaf;
+	r.solar = wxRound(wx.solar, 3, 1);
+	r.temp = wx.temp;
+	r.uv = wx.uv;
+	r.vcap = wx.vcap;
+	r.vsolar = wx.vsolar;
+	r.windd = wx.windd;
+	r.winddraw = wx.winddraw;
+	r.windgust = wx.windgust;
+	r.windgustd = wx.windgustd;
+	r.windv = wx.windv;
+	}
+
+	// 0, COBS(rec, CRC), 0
+size_t wxFrame(uint8_t *frame, uint8_t *rec, size_t len) {
+	uint16_t crc = DavisRFM69Base::crc16_ccitt(rec, len);
+	rec[len++] = crc >> 8;
+	rec[len++] = crc;
+	frame[0] = 0;
+	size_t n = 1 + cobsEncode(rec, len, frame + 1);
+	frame[n++] = 0;
+	return n;
+	}
+
+size_t wxRecordFrame(uint8_t *frame, const RadioData &rd, uint32_t packets, uint32_t lostPackets, const WxData &wx) {
+	struct __attribute__((packed)) {
+		WxRecord r;
+		uint8_t crc[2];
+		} f;
+	fillRecord(f.r, rd, packets, lostPackets, wx);
+	return wxFrame(frame, (uint8_t *) &f, sizeof(f.r));
+	}
+
+size_t WxRecordEncoder::frame(uint8_t *frame, const RadioData &rd, uint32_t packets, uint32_t lostPackets, const WxData &wx) {
+	struct __attribute__((packed)) {
+		WxRecord r;
+		uint8_t crc[2];
+		} f;
+	WxRecord &r = f.r;
+	fillRecord(r, rd, packets, lostPackets, wx);
+	uint8_t st = r.station;
+	WxRecord &last = sent[st];
+	if (sinceKey[st] == 0 || sinceKey[st] >= WXREC_KEYFRAME_EVERY
+		|| packets - last.packets > 0xff || lostPackets - last.lostPackets > 0xff) {
+		last = r;
+		sinceKey[st] = 1;
+		return wxFrame(frame, (uint8_t *) &f, sizeof(r));
+		}
+	sinceKey[st]++;
+
+	// header, the fields that differ from what was sent, CRC
+	uint8_t delta[WXREC_DELTA_HEAD + sizeof(WxRecord) + 2];
+	uint8_t *p = delta + WXREC_DELTA_HEAD;
+	const uint8_t *now = (const uint8_t *) &r;
+	uint8_t *before = (uint8_t *) &last;
+	uint16_t mask = 0;
+	for (uint8_t i = 0; i < WXREC_FIELDS; i++) {
+		const WxRecordField &fd = wxRecordFields[i];
+		if (memcmp(now + fd.offset, before + fd.offset, fd.size) == 0) continue;
+		mask |= 1 << i;
+		memcpy(p, now + fd.offset, fd.size);
+		memcpy(before + fd.offset, now + fd.offset, fd.size);
+		p += fd.size;
+		}
+	// lostPackets as a reader has it after adding the low byte's difference
+	last.lostPackets = lostPackets;
+	last.packets = packets;
+	last.type = r.type;
+	last.rssi = r.rssi;
+	delta[0] = WXREC_DELTA | r.type << 3 | st;
+	delta[1] = r.rssi;
+	delta[2] = (uint8_t) packets;
+	delta[3] = sinceKey[st] - 1;
+	delta[4] = (uint8_t) mask;
+	delta[5] = mask >> 8;
+	return wxFrame(frame, delta, p - delta);
+	}
@@ -0,0 +1,206 @@
+// Binary weather record: what the sketch sends per packet instead of the "c:" CSV line.
+//
+// A record is WxRecord as it is in memory, little endian (the SAMD21 and the hosts
+// reading it are), followed by its CRC16-CCITT big endian, so the CRC over the whole of
+// it comes out 0. That is COBS encoded, which leaves no 0 bytes in it, and sent between
+// two 0 delimiters, in one Serial.write():
+//
+//   00 COBS(record, CRC) 00
+//
+// A reader starts over at every 0, so text lines on the same port (bme:, the debug
+// output) only cost it the chunk they are in. host/WxRecordDecoder decodes the stream.
+//
+// Versions only ever add fields at the end of WxRecord: a reader takes the fields it
+// knows from a newer record and zeroes the ones an older record doesn't have. They stay
+// below WXREC_SUMMARY.
+//
+// Delta records (WxRecordEncoder) carry only what changed since the station's previous
+// record: a 6 byte header, then the fields whose bit is set in its mask, in WXREC_F_XXX
+// order, each as it is in WxRecord; framed the same way.
+//
+//   0x80 | type << 3 | station, rssi, packets & 0xff, seq, mask (u16), fields...
+//
+// packets, and lostPackets in WXREC_F_LOST, are sent as their low byte: a reader adds
+// the difference to what it had. seq counts the station's records since its last full
+// one, from 1, so a reader can tell that it missed one, and with it a change, and waits
+// for the next full record. Every WXREC_KEYFRAME_EVERY records of a station, and
+// whenever a difference would not fit, the station gets a full record instead, from
+// which a reader that missed records, or started late, picks up.
+//
+// Summary records (WxSummary, from DavisRFM69_batch.h) sum up a station's packets over a
+// batch interval instead, one per station heard in it; framed the same way.
+
+#ifndef DAVISRFM69_RECORD_h
+#define DAVISRFM69_RECORD_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WXREC_VERSION		1
+
+#define WXREC_BATT_LOW		0x01	// flags: the transmitter reports a low battery
+
+#define WXREC_NONE			(-1)	// solar, uv, soilleaf, vcap, vsolar: no reading
+
+#define WXREC_DELTA			0x80	// first byte of a delta record, with the type and station
+#define WXREC_DELTA_HEAD	6		// header bytes of a delta record
+#define WXREC_KEYFRAME_EVERY	32	// a station's full record every this many of its records
+#define WXREC_SUMMARY		0x7f	// first byte of a summary record
+
+struct __attribute__((packed)) WxRecord {
+	uint8_t version;		// WXREC_VERSION
+	uint8_t station;		// station id, 0..7
+	uint8_t type;			// packet type (VP2P_XXX, VUEP_XXX): the reading this packet updated
+	uint8_t flags;			// WXREC_XXX
+	uint8_t rssi;			// -dBm
+	uint32_t packets;		// received so far, all stations
+	uint32_t lostPackets;	// ...and missed
+	// the sketch's WxData: this station's last values
+	uint8_t rain;			// rain bucket tips counter, 0..127, 255 when invalid
+	uint16_t rainrate;		// 0.01"/hr
+	uint16_t rh;			// 0.1 %
+	int16_t soilleaf;
+	int16_t solar;			// 0.1 W/m2
+	int16_t temp;			// 0.1 F
+	int16_t uv;				// 0.01 UV index
+	int16_t vcap;			// 0.01 V
+	int16_t vsolar;			// 0.01 V
+	uint16_t windd;			// degrees
+	uint8_t winddraw;
+	uint8_t windgust;		// mph
+	uint8_t windgustd;		// 16 points of the compass
+	uint16_t windv;			// mph
+	};
+
+#define WXREC_V1_SIZE		37		// sizeof(WxRecord) as of version 1
+#define WXREC_MAX_SIZE		64		// the longest record a reader takes, later versions included
+	// leading 0, COBS code byte, record, CRC, trailing 0 (COBS adds a byte per 254)
+#define WXREC_FRAME_MAX		(sizeof(WxRecord) + 5)
+
+static_assert(sizeof(WxRecord) >= WXREC_V1_SIZE && sizeof(WxRecord) <= WXREC_MAX_SIZE, "WxRecord layout");
+
+	// Delta record fields: bit of the mask, and where the value is in WxRecord
+#define WXREC_F_FLAGS		0
+#define WXREC_F_LOST		1		// lostPackets & 0xff
+#define WXREC_F_RAIN		2
+#define WXREC_F_RAINRATE	3
+#define WXREC_F_RH			4
+#define WXREC_F_SOILLEAF	5
+#define WXREC_F_SOLAR		6
+#define WXREC_F_TEMP		7
+#define WXREC_F_UV			8
+#define WXREC_F_VCAP		9
+#define WXREC_F_VSOLAR		10
+#define WXREC_F_WINDD		11
+#define WXREC_F_WINDDRAW	12
+#define WXREC_F_WINDGUST	13
+#define WXREC_F_WINDGUSTD	14
+#define WXREC_F_WINDV		15
+#define WXREC_FIELDS		16
+
+struct WxRecordField {
+	uint8_t offset;
+	uint8_t size;
+	};
+
+static const WxRecordField wxRecordFields[WXREC_FIELDS] = {
+	{ offsetof(WxRecord, flags), 1 }, { offsetof(WxRecord, lostPackets), 1 }, { offsetof(WxRecord, rain), 1 },
+	{ offsetof(WxRecord, rainrate), 2 }, { offsetof(WxRecord, rh), 2 }, { offsetof(WxRecord, soilleaf), 2 },
+	{ offsetof(WxRecord, solar), 2 }, { offsetof(WxRecord, temp), 2 }, { offsetof(WxRecord, uv), 2 },
+	{ offsetof(WxRecord, vcap), 2 }, { offsetof(WxRecord, vsolar), 2 }, { offsetof(WxRecord, windd), 2 },
+	{ offsetof(WxRecord, winddraw), 1 }, { offsetof(WxRecord, windgust), 1 }, { offsetof(WxRecord, windgustd), 1 },
+	{ offsetof(WxRecord, windv), 2 } };
+
+	// A station's packets over one batch interval
+struct __attribute__((packed)) WxSummary {
+	uint8_t kind;			// WXREC_SUMMARY
+	uint8_t station;		// station id, 0..7
+	uint8_t flags;			// WXREC_XXX, of any of the packets
+	uint8_t count;			// the station's packets in the interval
+	uint16_t seconds;		// from the interval's first packet, of any station, to the summary
+	uint8_t rssi;			// -dBm, mean
+	uint32_t packets;		// received so far, all stations
+	uint32_t lostPackets;	// ...and missed
+	uint16_t windAvg;		// 0.1 mph, mean of the packets' wind speeds
+	uint8_t windMin;		// mph
+	uint8_t windMax;
+	uint16_t windd;			// degrees, last
+	uint8_t windgust;		// mph, highest reported
+	uint8_t windgustd;		// ...and its direction
+	int16_t temp;			// last
+	int16_t tempMin;		// of the interval's temperature packets, else the last
+	int16_t tempMax;
+	uint16_t rh;			// last
+	uint8_t rain;			// bucket tips in the interval
+	uint16_t rainrate;		// highest
+	int16_t solar;			// last, as in WxRecord
+	int16_t uv;
+	int16_t vcap;
+	int16_t vsolar;
+	int16_t soilleaf;
+	};
+
+#define WXREC_SUMMARY_SIZE	44		// sizeof(WxSummary)
+#define WXREC_SUMMARY_FRAME_MAX	(sizeof(WxSummary) + 5)
+
+static_assert(sizeof(WxSummary) == WXREC_SUMMARY_SIZE && sizeof(WxSummary) <= WXREC_MAX_SIZE, "WxSummary layout");
+
+struct RadioData;
+struct WxData;
+
+	// Frame len bytes of rec, which has room for the CRC after them, into frame; returns its length
+size_t wxFrame(uint8_t *frame, uint8_t *rec, size_t len);
+
+	// The frame for one packet into frame (WXREC_FRAME_MAX bytes); returns its length
+size_t wxRecordFrame(uint8_t *frame, const RadioData &rd, uint32_t packets, uint32_t lostPackets, const WxData &wx);
+
+	// Frames packets as delta records against what it last sent for their station, or
+	// as full records when a station is due a keyframe
+class WxRecordEncoder {
+public:
+	WxRecordEncoder() { reset(); }
+
+		// The frame for one packet into frame (WXREC_FRAME_MAX bytes); returns its length
+	size_t frame(uint8_t *frame, const RadioData &rd, uint32_t packets, uint32_t lostPackets, const WxData &wx);
+		// Send every station a full record next, e.g. when a reader (re)connects
+	void reset() { for (uint8_t i = 0; i < 8; i++) sinceKey[i] = 0; }
+
+private:
+	WxRecord sent[8];			// each station's last record as a reader has it
+	uint8_t sinceKey[8];		// records since the station's last keyframe, 0: one is due
+	};
+
+	// COBS encode len bytes of in into out, which takes len + len / 254 + 1; returns its length
+static inline size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+	uint8_t *start = out;
+	uint8_t *code = out++;
+	uint8_t run = 1;
+	for (size_t i = 0; i < len; i++) {
+		if (in[i] != 0) {
+			*out++ = in[i];
+			if (++run < 0xff) continue;
+			}
+		// a 0, or 254 bytes without one
+		*code = run;
+		code = out++;
+		run = 1;
+		}
+	*code = run;
+	return out - start;
+	}
+
+	// Decode len bytes of COBS (no 0 among them) into out, which takes len; returns the
+	// decoded length, or -1 if a code runs past the end
+static inline int cobsDecode(const uint8_t *in, size_t len, uint8_t *out) {
+	const uint8_t *end = in + len;
+	uint8_t *start = out;
+	while (in < end) {
+		uint8_t run = *in++;
+		if (run == 0 || run - 1 > end - in) return -1;
+		for (uint8_t k = 1; k < run; k++) *out++ = *in++;
+		if (run < 0xff && in < end) *out++ = 0;
+		}
+	return out - start;
+	}
+
+#endif  // DAVISRFM69_RECORD_h
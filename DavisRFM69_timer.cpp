@@ -0,0 +1,74 @@
+// SAMD21 implementation of the tune-in timer used by DavisRFM69 (DAVISRFM69_TIMER_TUNE).
+//
+// TC4 and TC5 chained as one 32 bit counter at 3 MHz (GCLK0 / 16), in one-shot mode with
+// CC0 as the top, so the overflow interrupt marks the wakeup. Good for 23 minutes ahead.
+//
+// This defines TC4_Handler, so TC4/TC5 can't be used by anything else in the sketch.
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+
+#if defined(DAVISRFM69_TIMER_TUNE) && defined(ARDUINO_ARCH_SAMD)
+
+#include "DavisRFM69_timer.h"
+
+#define TUNE_TC			TC4
+#define TUNE_TC_IRQn	TC4_IRQn
+#define TICKS_PER_US	3
+
+static void (*fireCallback)();
+
+static inline void tcSync() {
+	while (TUNE_TC->COUNT32.STATUS.bit.SYNCBUSY);
+	}
+
+void tuneTimerBegin(void (*fire)()) {
+	fireCallback = fire;
+	PM->APBCMASK.reg |= PM_APBCMASK_TC4 | PM_APBCMASK_TC5;
+	GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TC4_TC5;
+	while (GCLK->STATUS.bit.SYNCBUSY);
+
+	TUNE_TC->COUNT32.CTRLA.reg = TC_CTRLA_SWRST;
+	while (TUNE_TC->COUNT32.CTRLA.bit.SWRST);
+	TUNE_TC->COUNT32.CTRLA.reg = TC_CTRLA_MODE_COUNT32 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV16;
+	tcSync();
+	TUNE_TC->COUNT32.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+	tcSync();
+	TUNE_TC->COUNT32.INTENSET.reg = TC_INTENSET_OVF;
+	TUNE_TC->COUNT32.CTRLA.bit.ENABLE = 1;
+	tcSync();
+	// enabling starts a one-shot run; stop it until there is something to wait for
+	TUNE_TC->COUNT32.CTRLBSET.reg = TC_CTRLBSET_CMD_STOP;
+	tcSync();
+	TUNE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_OVF;
+
+	NVIC_ClearPendingIRQ(TUNE_TC_IRQn);
+	NVIC_EnableIRQ(TUNE_TC_IRQn);
+	}
+
+void tuneTimerArm(uint32_t at) {
+	int32_t us = at - micros();
+	if (us < 1) us = 1;
+	TUNE_TC->COUNT32.CTRLBSET.reg = TC_CTRLBSET_CMD_STOP;
+	tcSync();
+	TUNE_TC->COUNT32.CC[0].reg = (uint32_t) us * TICKS_PER_US;
+	tcSync();
+	TUNE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_OVF;
+	TUNE_TC->COUNT32.CTRLBSET.reg = TC_CTRLBSET_CMD_RETRIGGER;
+	tcSync();
+	}
+
+void tuneTimerCancel() {
+	TUNE_TC->COUNT32.CTRLBSET.reg = TC_CTRLBSET_CMD_STOP;
+	tcSync();
+	TUNE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_OVF;
+	}
+
+void TC4_Handler() {
+	if (TUNE_TC->COUNT32.INTFLAG.bit.OVF) {
+		TUNE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_OVF;
+		if (fireCallback) fireCallback();
+		}
+	}
+
+#endif  // DAVISRFM69_TIMER_TUNE && ARDUINO_ARCH_SAMD
@@ -0,0 +1,17 @@
+// One-shot timer used by DavisRFM69 to tune in to stations on time (DAVISRFM69_TIMER_TUNE).
+//
+// Implemented with SAMD21 TC4/TC5 in DavisRFM69_timer.cpp, and by a simulated timer in
+// host/TimerSim.cpp for host builds.
+
+#ifndef DAVISRFM69_TIMER_h
+#define DAVISRFM69_TIMER_h
+
+	// One-time setup, called from DavisRFM69::initialize(); fire runs from the timer interrupt
+void tuneTimerBegin(void (*fire)());
+
+	// Fire once at micros() == at (right away if that has passed), replacing any earlier setting
+void tuneTimerArm(uint32_t at);
+
+void tuneTimerCancel();
+
+#endif  // DAVISRFM69_TIMER_h
@@ -0,0 +1,76 @@
+// Binary event trace for DavisRFM69 debugging (DAVISRFM69_DEBUG).
+//
+// Writers are loop() and the driver's interrupt handlers, the only reader is traceFlush()
+// from loop(). The Cortex-M0+ has no exclusive load/store, so a writer claims and fills its
+// slot with interrupts masked (PRIMASK saved and restored, so it is safe inside an ISR);
+// that is a dozen instructions whatever the ring holds. The reader copies the record at
+// the tail before releasing it, and writers never touch a slot that hasn't been released.
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+
+#ifdef DAVISRFM69_DEBUG
+
+#include "DavisRFM69_trace.h"
+
+static TraceRecord traceBuf[TRACE_SIZE];
+static volatile uint16_t traceHead, traceTail;	// free running, index with & (TRACE_SIZE - 1)
+static volatile uint32_t traceLost;
+static uint32_t traceLostReported;
+
+void traceEvent(uint8_t event, uint8_t a, uint16_t b, uint32_t c) {
+	uint32_t now = micros();
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint16_t head = traceHead;
+	if ((uint16_t) (head - traceTail) < TRACE_SIZE) {
+		TraceRecord *r = &traceBuf[head & (TRACE_SIZE - 1)];
+		r->time = now;
+		r->event = event;
+		r->a = a;
+		r->b = b;
+		r->c = c;
+		traceHead = head + 1;
+		}
+	else traceLost++;
+	__set_PRIMASK(primask);
+	}
+
+static char *putHex(char *p, uint32_t v, uint8_t digits) {
+	while (digits) *p++ = "0123456789ABCDEF"[(v >> (4 * --digits)) & 0xf];
+	return p;
+	}
+
+static void writeRecord(const TraceRecord &r) {
+	char line[TRACE_LINE_LEN];
+	char *p = line;
+	*p++ = 't';
+	*p++ = ':';
+	p = putHex(p, r.time, 8);
+	p = putHex(p, r.event, 2);
+	p = putHex(p, r.a, 2);
+	p = putHex(p, r.b, 4);
+	p = putHex(p, r.c, 8);
+	*p++ = '\r';
+	*p++ = '\n';
+	Serial.write((const uint8_t *) line, p - line);
+	}
+
+void traceFlush() {
+	while (Serial.availableForWrite() >= TRACE_LINE_LEN) {
+		uint32_t lost = traceLost;
+		if (lost != traceLostReported) {
+			TraceRecord r = { micros(), TR_OVERFLOW, 0, 0, lost };
+			writeRecord(r);
+			traceLostReported = lost;
+			continue;
+			}
+		uint16_t tail = traceTail;
+		if (tail == traceHead) break;
+		TraceRecord r = traceBuf[tail & (TRACE_SIZE - 1)];
+		traceTail = tail + 1;
+		writeRecord(r);
+		}
+	}
+
+#endif  // DAVISRFM69_DEBUG
@@ -0,0 +1,52 @@
+// Binary event trace for DavisRFM69 debugging (DAVISRFM69_DEBUG).
+//
+// The driver records fixed size events into a RAM ring from loop() and from its interrupt
+// handlers; recording never blocks. traceFlush() moves them to Serial as "t:" lines of hex,
+// only as much as fits in the serial buffer without waiting. host/trace_decode turns a
+// captured log back into text.
+//
+//   t:TTTTTTTTEEAABBBBCCCCCCCC   time (micros()), event, a, b, c, all big endian hex
+
+#ifndef DAVISRFM69_TRACE_h
+#define DAVISRFM69_TRACE_h
+
+#include <stdint.h>
+
+#define TRACE_SIZE			64		// records, power of 2
+#define TRACE_LINE_LEN		28		// "t:", 24 hex digits, "\r\n"
+
+// Events and what their arguments hold
+#define TR_MISSED			1		// a: station id, b: channel
+#define TR_LOST				2		// a: station id, now resyncing
+#define TR_TUNE_CHECK		3		// a: station id, b: channel, c: us until due (DAVISRFM69_DEBUG_VERBOSE)
+#define TR_TUNE				4		// a: station id, b: channel, c: us until due
+#define TR_SYNC				5		// a: station id, b: channel, c: dwell us
+#define TR_SYNC_FAIL		6		// a: station id, b: next channel, c: dwell us
+#define TR_PROGRESS			7		// a: percent of the dwell listened, c: free memory
+#define TR_SLEEP			8		// nothing to receive
+#define TR_FOUND			9		// a: station index, c: interval us
+#define TR_EARLY			10		// a: station index, c: us from tune-in to packet
+#define TR_CHANNEL			11		// a: channel, c: FRF correction, Fstep
+#define TR_MODE				12		// a: old mode, b: new mode
+#define TR_CRC_ERROR		13		// a: channel
+#define TR_RAW_DROPPED		14		// a: channel
+#define TR_OVERFLOW			15		// c: records lost to a full ring so far
+#define TR_REACQUIRE		16		// a: station id, b: channel, c: us either side of the prediction
+#define TR_COLLISION		17		// a: station id kept, b: station id given up on, c: us between their packets
+#define TR_COUNT			18
+
+struct TraceRecord {
+	uint32_t time;
+	uint8_t event;
+	uint8_t a;
+	uint16_t b;
+	uint32_t c;
+	};
+
+	// Record an event, from any context. Dropped (and counted) when the ring is full.
+void traceEvent(uint8_t event, uint8_t a, uint16_t b, uint32_t c);
+
+	// Write out pending records while Serial can take them without blocking
+void traceFlush();
+
+#endif  // DAVISRFM69_TRACE_h
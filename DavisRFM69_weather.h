@@ -0,0 +1,87 @@
+// The last readings of each station.
+//
+// A packet carries wind and one other reading of the station that sent it, so a
+// station's WxData builds up over its packets and must not take readings from another
+// station's. WxStations keeps a WxData per station ID (packet[0] & 7), updated in place:
+// update() hands out the station's WxData to decode a packet into, done() marks it
+// changed.
+//
+// snapshot() is a view of all stations at that moment without copying their data: which
+// were heard, which changed since the previous snapshot, and each one's WxData by
+// reference. The view holds as long as no station is updated after it was taken, which
+// current() tells; decoding and output both run from loop(), so one taken and used in
+// the same pass always does.
+//
+//   WxData &wx = weather.update(packet[0] & 7);
+//   ... decode packet into wx ...
+//   weather.done(packet[0] & 7);
+//
+//   WxSnapshot s = weather.snapshot();
+//   for (byte id = 0; id < WX_STATIONS; id++) if (s.isChanged(id)) send(id, s[id]);
+
+#ifndef DAVISRFM69_WEATHER_h
+#define DAVISRFM69_WEATHER_h
+
+#include "DavisRFM69.h"
+
+#define WX_STATIONS			8	// station IDs are 3 bits
+
+class WxStations;
+
+struct WxSnapshot {
+	const WxStations *source;
+	uint32_t updates;			// source's update count when taken
+	byte heard;					// bit per station ID: has data
+	byte changed;				// ...updated since the previous snapshot
+
+	bool isHeard(byte id) const { return heard >> id & 1; }
+	bool isChanged(byte id) const { return changed >> id & 1; }
+	inline const WxData &operator[](byte id) const;
+	inline bool current() const;
+	};
+
+class WxStations {
+public:
+	WxStations() : updates(0), heard(0), changed(0) {}
+
+		// The WxData of station id, to decode its packet into; done() when finished
+	WxData &update(byte id) { return data[id & (WX_STATIONS - 1)]; }
+	void done(byte id) {
+		byte bit = 1 << (id & (WX_STATIONS - 1));
+		heard |= bit;
+		changed |= bit;
+		updates++;
+		}
+
+	const WxData &operator[](byte id) const { return data[id & (WX_STATIONS - 1)]; }
+	bool isHeard(byte id) const { return heard >> (id & (WX_STATIONS - 1)) & 1; }
+
+		// All stations as they are now; starts over which have changed
+	WxSnapshot snapshot() {
+		WxSnapshot s = { this, updates, heard, changed };
+		changed = 0;
+		return s;
+		}
+
+		// Forget a station's readings, e.g. when it was replaced by another with its ID
+	void clear(byte id) {
+		data[id & (WX_STATIONS - 1)] = WxData();
+		heard &= ~(1 << (id & (WX_STATIONS - 1)));
+		changed &= ~(1 << (id & (WX_STATIONS - 1)));
+		updates++;
+		}
+
+private:
+	friend struct WxSnapshot;
+	WxData data[WX_STATIONS];
+	uint32_t updates;			// done() and clear() calls
+	byte heard;
+	byte changed;
+	};
+
+const WxData &WxSnapshot::operator[](byte id) const { return source->data[id & (WX_STATIONS - 1)]; }
+
+	// no station was updated since the snapshot was taken: what it refers to is what it saw
+bool WxSnapshot::current() const { return source->updates == updates; }
+
+#endif  // DAVISRFM69_WEATHER_h
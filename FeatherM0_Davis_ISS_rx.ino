@@ -4,6 +4,10 @@
 #include <SPI.h>
 
 #include "DavisRFM69.h"
+#include "DavisRFM69_batch.h"
+#include "DavisRFM69_decode.h"
+#include "DavisRFM69_record.h"
+#include "DavisRFM69_weather.h"
 #include "RFM69registers.h"
 #include <Wire.h>
 #include <SparkFunBME280.h>
@@ -11,9 +15,25 @@
 
 #define BME_DEBUG
 
+// Send each packet's readings as a binary record (DavisRFM69_record.h, decoded on the
+// host by host/WxRecordDecoder) rather than the "c:" CSV line, unless CSV_OUTPUT is defined
+//#define CSV_OUTPUT
+// ...and with DELTA_OUTPUT, only the fields that changed since the station's previous
+// record, with a full record every WXREC_KEYFRAME_EVERY (records decoded by the same reader)
+//#define DELTA_OUTPUT
+// With BATCH_OUTPUT, a summary record per station every BATCH_PACKETS packets or
+// BATCH_SECONDS seconds instead (wind min/max/mean, temperature range, rain tips, ...),
+// for slow links: about a tenth of the bytes, the readings up to BATCH_SECONDS late
+//#define BATCH_OUTPUT
+#define BATCH_PACKETS	24
+#define BATCH_SECONDS	60
+// Print at boot how many cycles the float and the integer sensor decoding take per packet
+// (DavisRFM69_decode.h), each over every raw value
+//#define DECODE_BENCH
+
 BME280 mySensor;
 boolean bme_valid = false;
-DavisRFM69 radio(SPI_CS,RF69_IRQ_PIN,RF69_IRQ_NUM);
+DavisRFM69Radio<FREQ_BAND_US, 2, FIFO_SIZE> radio(SPI_CS,RF69_IRQ_PIN,RF69_IRQ_NUM);	// US band, the two stations below
 unsigned long time=0;
 int bme_loop = 0;
 float temperature=NAN;
@@ -28,7 +48,13 @@ Station stations[2] = {
 	{ .id = 2, .type = ISS_TYPE, .active = true }
  }; 
 
-WxData curWx;
+WxStations weather;		// the last readings of each station ID
+#ifdef DELTA_OUTPUT
+WxRecordEncoder records;
+#endif
+#ifdef BATCH_OUTPUT
+WxBatcher batch(BATCH_PACKETS, BATCH_SECONDS * 1000UL);
+#endif
 
 //  Report the amount of memory between the heap and the stack. Call freeMemory() to get the amount at that point.
 //  From: https://github.com/mpflaga/Arduino-MemoryFree				 Added by JF
@@ -53,6 +79,44 @@ void bme_setup() {
   mySensor.setMode(MODE_NORMAL); //MODE_SLEEP, MODE_FORCED, MODE_NORMAL is valid. See 3.3
 }
 
+#ifdef DECODE_BENCH
+volatile int32_t benchSink;
+
+	// Cycles per call of decode, over every packet[3] and [4] (packet[2] along with [3]). The
+	// M0+ has no cycle counter: SysTick counts the core clock down from LOAD, once a millisecond.
+template <typename Decode> float bench_cycles(Decode decode) {
+	byte packet[DAVIS_PACKET_LEN] = { 0 };
+	uint32_t reload = SysTick->LOAD + 1, total = 0;
+	for (uint32_t v = 0; v < 0x10000; v++) {
+		packet[2] = v >> 8;
+		packet[3] = v >> 8;
+		packet[4] = v;
+		if (wxRainRateZero(packet)) packet[3] = 1;			// keep the float rain rate defined
+		noInterrupts();
+		uint32_t start = SysTick->VAL;
+		benchSink = decode(packet);
+		uint32_t end = SysTick->VAL;
+		interrupts();
+		total += (start - end + reload) % reload;
+		}
+	return total / 65536.0;
+	}
+
+void decode_bench() {
+	float base = bench_cycles([](const byte *p) -> int32_t { return p[3]; });	// the call and the timing
+	Serial.println(F("decode cycles: float, fixed"));
+	Serial.print(F("windd vp2: ")); Serial.print(bench_cycles([](const byte *p) -> int32_t { return wxWindDirFloat(p, false); }) - base);
+	Serial.print(F(", ")); Serial.println(bench_cycles([](const byte *p) -> int32_t { return wxWindDir(p, false); }) - base);
+	Serial.print(F("windd vue: ")); Serial.print(bench_cycles([](const byte *p) -> int32_t { return wxWindDirFloat(p, true); }) - base);
+	Serial.print(F(", ")); Serial.println(bench_cycles([](const byte *p) -> int32_t { return wxWindDir(p, true); }) - base);
+	Serial.print(F("uv: ")); Serial.print(bench_cycles([](const byte *p) -> int32_t { return wxUvFloat(p); }) - base);
+	Serial.print(F(", ")); Serial.println(bench_cycles([](const byte *p) -> int32_t { return wxUv(p); }) - base);
+	Serial.print(F("solar: ")); Serial.print(bench_cycles([](const byte *p) -> int32_t { return wxSolarFloat(p); }) - base);
+	Serial.print(F(", ")); Serial.println(bench_cycles([](const byte *p) -> int32_t { return wxSolar(p); }) - base);
+	Serial.print(F("rainrate: ")); Serial.print(bench_cycles([](const byte *p) -> int32_t { return wxRainRateFloat(p); }) - base);
+	Serial.print(F(", ")); Serial.println(bench_cycles([](const byte *p) -> int32_t { return wxRainRate(p); }) - base);
+	}
+#endif
 
 void setup() {
 	Serial.begin(SERIAL_BAUD);
@@ -62,8 +126,7 @@ void setup() {
 	pinMode(LED, OUTPUT);
 	digitalWrite(LED, LOW);
 
-	DavisRFM69::stations = stations;
-	DavisRFM69::numStations = sizeof(stations)/sizeof(Station);
+	radio.setStations(stations, sizeof(stations)/sizeof(Station));
 
 	radio.initialize(FREQ_BAND_US);
 	//radio.setBandwidth(RF69_DAVIS_BW_NARROW);
@@ -77,6 +140,9 @@ void setup() {
 //  }
  
 
+#ifdef DECODE_BENCH
+	decode_bench();
+#endif
 	Serial.println("Boot complete!");
 	}
 
@@ -106,6 +172,11 @@ void print_value(const char* vname, float value, const __FlashStringHelper* sep)
 	Serial.print(vname); Serial.print(F(":")); Serial.print(value, 1); Serial.print(sep);
 	}
 
+	// value in 10^-scale units with decimals digits, as the float was printed; -1 none
+void print_value(const char* vname, int32_t value, byte scale, byte decimals, const __FlashStringHelper* sep) {
+	Serial.print(vname); Serial.print(F(":")); wxPrintFixed(value, scale, decimals); Serial.print(sep);
+	}
+
 void print_value(const char* vname, long value, const __FlashStringHelper* sep) {
 	Serial.print(vname); Serial.print(F(":")); Serial.print(value); Serial.print(sep);
 	}
@@ -115,10 +186,11 @@ void print_value(const char* vname, uint32_t value, const __FlashStringHelper* s
 	}
 
 void decode_packet() {
-	radio.qLen--;
-	RadioData* rd = &radio.packetFifo[radio.packetOut];
+	RadioData* rd = radio.packetFifo.peek();
 	byte* packet = rd->packet;
-	if (++radio.packetOut == FIFO_SIZE) radio.packetOut = 0;
+	WxData &curWx = weather.update(packet[0] & 0x7);		// this station's, not the last packet's
+	int ix = radio.findStation(packet[0] & 0x7);			// the radio's copy of stations[], as it has them now
+	const Station *station = ix >= 0 ? &radio.stations[ix] : NULL;
 
 
   // for more about the protocol see:
@@ -149,16 +221,7 @@ void decode_packet() {
    	curWx.winddraw = packet[2];							// The console occasionaly shows a speed of 7 with a raw of 6, somewhat random?
 
 	// wind data is present in every packet, windd == 0 (packet[2] == 0) means there's no anemometer
-	if (packet[2] != 0) {
-		if (stations[packet[0] & 0x7].type == STYPE_VUE) curWx.windd = round(((packet[2] << 1) | (packet[4] & 2) >> 1) * 0.703125);
-		else {
-			curWx.windd = 9 + round((packet[2] - 1) * 1.341176);
-			if (curWx.windd > 345) curWx.windd = ((curWx.windd - 345) * 2) + 345;			// Smooths out some of the dead zone around N similiar to console   JF
-			}
-		}
-	else {
-		curWx.windd = 0;
-		}
+	curWx.windd = wxWindDir(packet, (station ? station->type : ISS_TYPE) == STYPE_VUE);
 
 #ifdef DAVISRFM69_DEBUG
 	print_value("windv", curWx.windv, F(", "));
@@ -169,22 +232,18 @@ void decode_packet() {
 	switch (packet[0] >> 4) {
 
 			case VP2P_UV:
-				curWx.uv = word(packet[3], packet[4]) >> 6;
-				if (curWx.uv < 0x3ff) curWx.uv = (curWx.uv / 50.0);
-				else curWx.uv =  -1;
+				curWx.uv = wxUv(packet);							// 1/100ths
 
 #ifdef DAVISRFM69_DEBUG
-				print_value("uv", curWx.uv, F(", "));
+				print_value("uv", curWx.uv, 2, 1, F(", "));
 #endif
 				break;
 
 			case VP2P_SOLAR:
-				curWx.solar = word(packet[3], packet[4]) >> 6;
-				if (curWx.solar < 0x3fe) curWx.solar = (curWx.solar * 1.757936);
-				else curWx.solar = -1;
+				curWx.solar = wxSolar(packet);						// 1/1000ths
 				
 #ifdef DAVISRFM69_DEBUG
-				print_value("solar", curWx.solar, F(", "));
+				print_value("solar", curWx.solar, 3, 1, F(", "));
 #endif
 				break;
 
@@ -203,10 +262,7 @@ void decode_packet() {
 				// strong rain: byte4[5:4] as value[5:4] and byte3[7:4] as value[3:0] - 6 bits total
 				// packet[4] bit 6: strong == 0, light == 1
 
-				curWx.rainrate = (packet[4] & 0x30) << 4 | packet[3];
-				if (curWx.rainrate == 0x3ff) curWx.rainrate = 0;
-				else if ((packet[4] & 0x40) == 0) curWx.rainrate >>= 4;
-				curWx.rainrate = round(3600.0 / curWx.rainrate); // Equals 0.01"/hr
+				curWx.rainrate = wxRainRate(packet);				// Equals 0.01"/hr, 0 when not raining
 				
 #ifdef DAVISRFM69_DEBUG
 				print_value("rainsecs", curWx.rainrate, F(", "));
@@ -267,7 +323,7 @@ void decode_packet() {
 
 
 #ifdef DAVISRFM69_DEBUG
-	int diff = rd->delta - stations[packet[0] & 0x7].interval;					// Added by JF
+	int diff = station ? rd->delta - station->interval : 0;						// Added by JF
 	print_value("fei", round(rd->fei * 61.03515625 / 1000), F(", "));
 	print_value("delta", rd->delta, F(", "));
 	print_value("diff", diff, F(", "));
@@ -276,9 +332,13 @@ void decode_packet() {
 #endif
 
 //	Fine tunes timing but not needed as diff is usually small anyway   JF
-//	if (rd->delta >= 1 && diff <= TUNEIN_USEC) stations[packet[0] & 0x7].interval = stations[packet[0] & 0x7].interval  + (diff/2);	
+//	if (station && rd->delta >= 1 && diff <= TUNEIN_USEC) radio.stations[ix].interval = station->interval  + (diff/2);	
 
+	weather.done(packet[0] & 0x7);
 
+#if defined(BATCH_OUTPUT)
+	batch.add(*rd, curWx, millis());
+#elif defined(CSV_OUTPUT)
 	Serial.print("c:");
 	Serial.print(radio.packets + radio.lostPackets);
 	Serial.print(",");
@@ -294,11 +354,11 @@ void decode_packet() {
 	Serial.print(",");
 	Serial.print(curWx.rh);
 	Serial.print(",");
-	Serial.print(curWx.solar);
+	wxPrintFixed(curWx.solar, 3, 2);
 	Serial.print(",");
 	Serial.print(curWx.temp);
 	Serial.print(",");
-	Serial.print(curWx.uv);
+	wxPrintFixed(curWx.uv, 2, 2);
 	Serial.print(",");
 	Serial.print(curWx.vcap);
 	Serial.print(",");
@@ -315,6 +375,15 @@ void decode_packet() {
 	Serial.print(curWx.windv);
 
 	Serial.println();
+#else
+	byte frame[WXREC_FRAME_MAX];
+#ifdef DELTA_OUTPUT
+	Serial.write(frame, records.frame(frame, *rd, radio.packets, radio.lostPackets, curWx));
+#else
+	Serial.write(frame, wxRecordFrame(frame, *rd, radio.packets, radio.lostPackets, curWx));
+#endif
+#endif
+	radio.packetFifo.pop();
 	}
 
 #ifdef DAVISRFM69_DEBUG
@@ -368,7 +437,13 @@ void update_bme() {
 unsigned int blinky=0;
 void loop() {
 	unsigned long timenow;
-	if (radio.qLen > 0) decode_packet();
+	if (!radio.packetFifo.empty()) decode_packet();
+#ifdef BATCH_OUTPUT
+	if (batch.due(millis())) {
+		byte frame[WXREC_SUMMARY_FRAME_MAX];
+		while (size_t n = batch.nextFrame(frame, radio.packets, radio.lostPackets, millis())) Serial.write(frame, n);
+		}
+#endif
 	if (radio.mode == SM_RECEIVING)	digitalWrite(LED, HIGH);
 	else if (radio.mode == SM_SEARCHING) {
 		blinky++;
@@ -380,7 +455,11 @@ void loop() {
 	// Lazy wraparound check
 	if (timenow > time || time == 0 || (time > 100000 && timenow < 100000) ) {
 		time=timenow+BME_DELAY;
-		if (Serial.read() == 'r' ) NVIC_SystemReset();
+		int cmd = Serial.read();
+		if (cmd == 'r' ) NVIC_SystemReset();
+#ifdef DELTA_OUTPUT
+		if (cmd == 'k') records.reset();			// a reader that just connected asks for full records
+#endif
 	//Serial.println(micros());
 	//	update_bme();
 	//Serial.println(micros());
@@ -0,0 +1,127 @@
+// Simulated Feather M0 for host builds of the DavisRFM69 driver.
+
+#include <string.h>
+
+#include "HostBoard.h"
+
+HostBoard board;
+
+void HostBoard::reset() {
+	nowNs = 0;
+	spiByteNs = 1000;
+	serialByteNs = 0;
+	serialEcho = NULL;
+	spiBytes = 0;
+	spiTransactions = 0;
+	serialBytes = 0;
+	irqCount = 0;
+	memset(pins, 0, sizeof(pins));
+	memset(spiDevs, 0, sizeof(spiDevs));
+	memset(isrs, 0, sizeof(isrs));
+	selected = NULL;
+	pendingIrqs = 0;
+	timersArmed = 0;
+	irqEnabled = true;
+	isrDepth = 0;
+	}
+
+void HostBoard::attachSpiDevice(uint8_t csPin, SpiDevice *dev) {
+	if (csPin < HOST_NUM_PINS) spiDevs[csPin] = dev;
+	}
+
+void HostBoard::attach(uint8_t interruptNum, void (*isr)()) {
+	if (interruptNum < HOST_NUM_IRQS) isrs[interruptNum] = isr;
+	}
+
+void HostBoard::raiseIrq(uint8_t interruptNum) {
+	if (interruptNum >= HOST_NUM_IRQS || isrs[interruptNum] == NULL) return;
+	pendingIrqs |= 1UL << interruptNum;
+	dispatchPending();
+	}
+
+	// The NVIC does not nest equal priority interrupts, so an ISR that re-enables
+	// interrupts (DavisRFM69::unselect() does) still won't be re-entered.
+void HostBoard::dispatchPending() {
+	while (pendingIrqs && irqEnabled && isrDepth == 0) {
+		uint8_t n = __builtin_ctz(pendingIrqs);
+		pendingIrqs &= ~(1UL << n);
+		irqCount++;
+		isrDepth++;
+		bool wasEnabled = irqEnabled;
+		irqEnabled = false;
+		isrs[n]();
+		irqEnabled = wasEnabled;
+		isrDepth--;
+		}
+	}
+
+void HostBoard::setInterrupts(bool enabled) {
+	irqEnabled = enabled;
+	if (enabled) dispatchPending();
+	}
+
+void HostBoard::pinWrite(uint8_t pin, uint8_t val) {
+	if (pin >= HOST_NUM_PINS) return;
+	uint8_t old = pins[pin];
+	pins[pin] = val;
+	SpiDevice *dev = spiDevs[pin];
+	if (dev == NULL || old == val) return;
+	if (val == 0) {
+		selected = dev;
+		spiTransactions++;
+		dev->select();
+		}
+	else {
+		dev->unselect();
+		if (selected == dev) selected = NULL;
+		}
+	}
+
+uint8_t HostBoard::spiTransfer(uint8_t out) {
+	spiBytes++;
+	nowNs += spiByteNs;
+	return spiExchange(out);
+	}
+
+uint8_t HostBoard::spiExchange(uint8_t out) {
+	return selected ? selected->transfer(out) : 0xff;
+	}
+
+void HostBoard::schedule(uint8_t interruptNum, uint64_t atNs) {
+	if (interruptNum >= HOST_NUM_IRQS) return;
+	timerAt[interruptNum] = atNs;
+	timersArmed |= 1UL << interruptNum;
+	if (atNs <= nowNs) pollTimers();
+	}
+
+void HostBoard::cancel(uint8_t interruptNum) {
+	if (interruptNum < HOST_NUM_IRQS) timersArmed &= ~(1UL << interruptNum);
+	}
+
+uint64_t HostBoard::nextTimerNs() const {
+	uint64_t next = UINT64_MAX;
+	for (uint32_t armed = timersArmed; armed; armed &= armed - 1) {
+		uint8_t n = __builtin_ctz(armed);
+		if (timerAt[n] < next) next = timerAt[n];
+		}
+	return next;
+	}
+
+void HostBoard::pollTimers() {
+	for (uint32_t armed = timersArmed; armed; armed &= armed - 1) {
+		uint8_t n = __builtin_ctz(armed);
+		if (timerAt[n] <= nowNs) {
+			timersArmed &= ~(1UL << n);
+			raiseIrq(n);
+			}
+		}
+	}
+
+void HostBoard::serialWrite(const uint8_t *buf, size_t len) {
+	serialBytes += len;
+	advance((uint64_t) serialByteNs * len);
+	if (serialEcho) fwrite(buf, 1, len, serialEcho);
+	}
+
+	// provided by the sketch on the board, used by the driver's debug output
+int freeMemory() { return 0; }
@@ -0,0 +1,86 @@
+// Simulated Feather M0 for host builds of the DavisRFM69 driver.
+//
+// Owns the virtual clock behind micros()/millis(), the interrupt enable flag and attached
+// ISRs, and routes SPI traffic to the device whose chip select is LOW. SPI and Serial
+// traffic advance the clock by a configurable per-byte cost so that time spent in the
+// driver (including with interrupts masked) is visible in virtual time.
+
+#ifndef HOST_BOARD_h
+#define HOST_BOARD_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HOST_NUM_PINS 32
+#define HOST_NUM_IRQS 32
+
+// interrupt lines used by simulated on-chip peripherals
+#define HOST_IRQ_DMAC 31
+#define HOST_IRQ_TIMER 30
+
+class SpiDevice {
+public:
+	virtual ~SpiDevice() {}
+	virtual void select() = 0;
+	virtual uint8_t transfer(uint8_t out) = 0;
+	virtual void unselect() = 0;
+	};
+
+class HostBoard {
+public:
+	uint64_t nowNs;				// virtual time since boot
+	uint32_t spiByteNs;			// bus time charged per SPI byte (8 MHz SCK plus overhead)
+	uint32_t serialByteNs;		// time Serial.write() blocks per byte
+	FILE *serialEcho;			// when set, Serial output is copied here
+
+	uint64_t spiBytes;
+	uint64_t spiTransactions;
+	uint64_t serialBytes;
+	uint64_t irqCount;
+
+	HostBoard() { reset(); }
+	void reset();
+
+	void advance(uint64_t ns) { nowNs += ns; if (timersArmed) pollTimers(); }
+		// also fires a timer that came due while SPI transfers moved the clock
+	void advanceTo(uint64_t ns) { advance(ns > nowNs ? ns - nowNs : 0); }
+	void setMicros(uint32_t us) { nowNs = (uint64_t) us * 1000; }
+
+		// one-shot timer raising interruptNum at atNs, for simulated peripherals
+	void schedule(uint8_t interruptNum, uint64_t atNs);
+	void cancel(uint8_t interruptNum);
+	uint64_t nextTimerNs() const;
+
+	void attachSpiDevice(uint8_t csPin, SpiDevice *dev);
+		// rising edge on an interrupt line; runs the attached ISR now or when unmasked
+	void raiseIrq(uint8_t interruptNum);
+	bool inIsr() const { return isrDepth > 0; }
+	bool interruptsEnabled() const { return irqEnabled; }
+
+	// used by the Arduino/SPI shims
+	void pinWrite(uint8_t pin, uint8_t val);
+	uint8_t pinRead(uint8_t pin) const { return pin < HOST_NUM_PINS ? pins[pin] : 0; }
+	uint8_t spiTransfer(uint8_t out);
+	uint8_t spiExchange(uint8_t out);		// without charging bus time, for DMA
+	void setInterrupts(bool enabled);
+	void attach(uint8_t interruptNum, void (*isr)());
+	void serialWrite(const uint8_t *buf, size_t len);
+
+private:
+	uint8_t pins[HOST_NUM_PINS];
+	SpiDevice *spiDevs[HOST_NUM_PINS];
+	SpiDevice *selected;
+	void (*isrs[HOST_NUM_IRQS])();
+	uint32_t pendingIrqs;
+	uint32_t timersArmed;
+	uint64_t timerAt[HOST_NUM_IRQS];
+	bool irqEnabled;
+	uint8_t isrDepth;
+
+	void dispatchPending();
+	void pollTimers();
+	};
+
+extern HostBoard board;
+
+#endif  // HOST_BOARD_h
@@ -0,0 +1,157 @@
+// Discrete-event model of Davis ISS transmitters on the air, feeding an RFM69Model.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_frequencies.h"
+#include "IssSim.h"
+
+	// Representative message rotations; the rain counter goes out every other packet.
+static const uint8_t VP2_SEQ[] = { VP2P_TEMP, VP2P_RAIN, VP2P_RAINSECS, VP2P_RAIN, VP2P_UV, VP2P_RAIN,
+	VP2P_WINDGUST, VP2P_RAIN, VP2P_SOLAR, VP2P_RAIN, VP2P_HUMIDITY, VP2P_RAIN };
+static const uint8_t VUE_SEQ[] = { VP2P_TEMP, VP2P_RAIN, VUEP_VCAP, VP2P_RAIN, VP2P_RAINSECS, VP2P_RAIN,
+	VP2P_WINDGUST, VP2P_RAIN, VUEP_VSOLAR, VP2P_RAIN, VP2P_HUMIDITY, VP2P_RAIN };
+
+static uint16_t crc16(const uint8_t *buf, uint8_t len) {
+	uint16_t crc = 0;
+	while (len--) {
+		crc ^= *buf++ << 8;
+		for (int i = 0; i < 8; ++i) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	return crc;
+	}
+
+	// ISS bytes go out LSB first, so they land in the FIFO bit-reversed
+static uint8_t reverse(uint8_t b) {
+	uint8_t r = 0;
+	for (int i = 0; i < 8; i++) r |= ((b >> i) & 1) << (7 - i);
+	return r;
+	}
+
+IssSim::IssSim(RFM69Model &radio, uint8_t band, uint64_t seed)
+	: rx(radio), rx2(NULL), band(band), rnd(seed), rnd2(seed ^ 0x5eed2ULL) {
+	numStations = 0;
+	outageNs = 0;
+	outageEveryNs = 0;
+	chanSpreadHz = 0;
+	memset(stats, 0, sizeof(stats));
+	}
+
+void IssSim::addStation(const IssConfig &cfg) {
+	if (numStations >= ISS_SIM_MAX_STATIONS) return;
+	uint8_t i = numStations++;
+	config[i] = cfg;
+	intervalNs[i] = (uint64_t) ((41 + cfg.id) * 1e9 / 16 * (1 + cfg.driftPpm * 1e-6));
+	slotNs[i] = board.nowNs + (uint64_t) ((0.1 + 0.9 * rnd.uniform()) * intervalNs[i]);
+	nextTxNs[i] = jitter(i, slotNs[i]);
+	channel[i] = rnd.below(channels());
+	seq[i] = rnd.below(sizeof(VP2_SEQ));
+	for (uint8_t ch = 0; ch < channels(); ch++) {
+		int hz = cfg.freqOffsetHz;
+		if (chanSpreadHz) hz += (int) rnd.below(2 * chanSpreadHz + 1) - chanSpreadHz;
+		chanErr[i][ch] = (int16_t) (hz / 61.03515625);
+		}
+	}
+
+void IssSim::addReceiver(RFM69Model &radio) { rx2 = &radio; }
+
+	// where station i's carrier is on its current channel
+uint32_t IssSim::txFrf(uint8_t i) const {
+	return frf(channel[i]) + chanErr[i][channel[i]];
+	}
+
+uint64_t IssSim::jitter(uint8_t i, uint64_t slot) {
+	uint32_t j = config[i].txJitterUs;
+	if (j == 0) return slot;
+	return slot + ((int64_t) rnd.below(2 * j + 1) - j) * 1000;
+	}
+
+int IssSim::indexOf(uint8_t id) const {
+	for (uint8_t i = 0; i < numStations; i++)
+		if (config[i].id == id) return i;
+	return -1;
+	}
+
+uint8_t IssSim::channels() const { return bandTabLengths[band]; }
+
+uint32_t IssSim::frf(uint8_t ch) const {
+	return bandTab[band][ch];
+	}
+
+uint64_t IssSim::nextEventNs() const {
+	uint64_t next = UINT64_MAX;
+	for (uint8_t i = 0; i < numStations; i++)
+		if (nextTxNs[i] + ISS_AIRTIME_NS < next) next = nextTxNs[i] + ISS_AIRTIME_NS;
+	return next;
+	}
+
+void IssSim::run() {
+	for (;;) {
+		int8_t due = -1;
+		for (uint8_t i = 0; i < numStations; i++)
+			if (nextTxNs[i] + ISS_AIRTIME_NS <= board.nowNs && (due < 0 || nextTxNs[i] < nextTxNs[due])) due = i;
+		if (due < 0) return;
+		transmit(due);
+		}
+	}
+
+void IssSim::transmit(uint8_t i) {
+	stats[i].sent++;
+	bool outage = outageEveryNs && nextTxNs[i] % outageEveryNs < outageNs;
+	bool lost = rnd.uniform() * 100 < config[i].lossPct || outage;
+	bool lost2 = rx2 == NULL || rnd2.uniform() * 100 < config[i].lossPct || outage;
+	if (lost && lost2) stats[i].airLost++;
+	bool got = !lost && rx.hears(txFrf(i), nextTxNs[i]);
+	bool got2 = !lost2 && rx2->hears(txFrf(i), nextTxNs[i]);
+	if (got || got2) {
+		uint8_t fifoBytes[DAVIS_PACKET_LEN];
+		buildPacket(i, fifoBytes, got ? rnd : rnd2);
+		stats[i].heard++;
+		if (got) rx.receive(fifoBytes, DAVIS_PACKET_LEN, rssi(i, rnd), (int16_t) (txFrf(i) - rx.frf()));
+		if (got2) {
+			stats[i].heardSecond++;
+			rx2->receive(fifoBytes, DAVIS_PACKET_LEN, rssi(i, rnd2), (int16_t) (txFrf(i) - rx2->frf()));
+			}
+		}
+	slotNs[i] += intervalNs[i];
+	nextTxNs[i] = jitter(i, slotNs[i]);
+	channel[i] = (channel[i] + 1) % channels();
+	seq[i] = (seq[i] + 1) % sizeof(VP2_SEQ);
+	}
+
+int IssSim::rssi(uint8_t i, SimRandom &r) {
+	int dbm = config[i].rssiDbm;
+	if (config[i].rssiJitter) dbm += (int) r.below(2 * config[i].rssiJitter + 1) - config[i].rssiJitter;
+	return dbm;
+	}
+
+void IssSim::buildPacket(uint8_t i, uint8_t *fifoBytes, SimRandom &r) {
+	uint8_t type = config[i].vue ? VUE_SEQ[seq[i]] : VP2_SEQ[seq[i]];
+	uint8_t p[DAVIS_PACKET_LEN];
+	memset(p, 0, sizeof(p));
+	p[0] = (type << 4) | config[i].id;
+	p[1] = r.below(12);						// wind speed, mph
+	p[2] = 1 + r.below(255);					// wind direction
+	switch (type) {
+		case VP2P_TEMP: { int16_t t = (600 + r.below(200)) * 16; p[3] = t >> 8; p[4] = t; break; }
+		case VP2P_HUMIDITY: { uint16_t rh = 400 + r.below(500); p[3] = rh; p[4] = (rh >> 8) << 4; break; }
+		case VP2P_UV: { uint16_t uv = r.below(500) << 6; p[3] = uv >> 8; p[4] = uv; break; }
+		case VP2P_SOLAR: { uint16_t s = r.below(700) << 6; p[3] = s >> 8; p[4] = s; break; }
+		case VP2P_RAIN: p[3] = stats[i].sent / 500 & 0x7f; break;
+		case VP2P_RAINSECS: p[3] = 0xff; p[4] = 0x30; break;
+		case VP2P_WINDGUST: p[3] = r.below(30); p[5] = r.below(16) << 4; break;
+		case VUEP_VCAP:
+		case VUEP_VSOLAR: p[3] = 0x60 + r.below(0x20); p[4] = 0x40; break;
+		}
+	uint16_t crc = crc16(p, 6);
+	p[6] = crc >> 8;
+	p[7] = crc;
+	p[8] = p[9] = 0xff;
+	for (uint8_t k = 0; k < DAVIS_PACKET_LEN; k++) fifoBytes[k] = reverse(p[k]);
+	}
+
+void IssSim::countReceived(const uint8_t *packet) {
+	int i = indexOf(packet[0] & 7);
+	if (i >= 0) stats[i].received++;
+	}
@@ -0,0 +1,98 @@
+// Discrete-event model of Davis ISS transmitters on the air, feeding an RFM69Model.
+//
+// Each transmitter has its own ID, nominal (41 + id) / 16 s interval, crystal drift,
+// position in the band's hop sequence, packet type rotation, air loss and RSSI. Packets
+// are evaluated when they end: the receiver gets one if it listened on the right
+// frequency for the whole packet (see RFM69Model::hears()).
+//
+// A second receiver (addReceiver()) loses packets and draws its RSSI independently of
+// the first, from its own random sequence, so what the first sees is the same as with
+// it alone. Independent losses are the best case for diversity; two antennas on one
+// board fade together more than that.
+
+#ifndef ISS_SIM_h
+#define ISS_SIM_h
+
+#include <stdint.h>
+
+#include "RFM69Model.h"
+
+#define ISS_SIM_MAX_STATIONS 8
+#define ISS_SIM_MAX_CHANNELS 51
+#define ISS_AIRTIME_NS (16ULL * 8 * 1000000000ULL / 19200) // 4 preamble, 2 sync, 10 data bytes
+
+	// small deterministic PRNG so runs are repeatable for a given seed
+class SimRandom {
+public:
+	explicit SimRandom(uint64_t seed = 1) : s(seed ? seed : 1) {}
+	uint32_t next() { s ^= s << 13; s ^= s >> 7; s ^= s << 17; return (uint32_t) (s >> 16); }
+	double uniform() { return next() / 4294967296.0; }
+	uint32_t below(uint32_t n) { return (uint32_t) (uniform() * n); }
+private:
+	uint64_t s;
+	};
+
+struct IssConfig {
+	uint8_t id;				// 0..7, one less than the DIP switch setting
+	double driftPpm;		// transmitter clock error
+	double lossPct;			// probability of losing any one packet on the air
+	int rssiDbm;			// mean received signal strength
+	int rssiJitter;			// +- uniform spread around rssiDbm
+	bool vue;				// Vue packet type rotation instead of VP2
+	uint32_t txJitterUs;	// +- uniform spread of each packet's start around the schedule
+	int freqOffsetHz;		// carrier offset from the band table
+	};
+
+struct IssStats {
+	uint32_t sent;			// packets transmitted
+	uint32_t airLost;		// dropped by the configured air loss (at every receiver)
+	uint32_t heard;			// landed in a receiver FIFO
+	uint32_t heardSecond;	// ...in the second receiver's
+	uint32_t received;		// came out of the driver's packet queue
+	};
+
+class IssSim {
+public:
+	IssConfig config[ISS_SIM_MAX_STATIONS];
+	IssStats stats[ISS_SIM_MAX_STATIONS];
+	uint8_t numStations;
+	uint64_t outageNs;			// all packets are lost for this long...
+	uint64_t outageEveryNs;		// ...at the start of every period this long (0: never)
+	int chanSpreadHz;			// +- uniform, fixed carrier error of each station on each channel
+
+	IssSim(RFM69Model &radio, uint8_t band, uint64_t seed);
+
+	void addStation(const IssConfig &cfg);
+	void addReceiver(RFM69Model &radio);
+		// end time of the next packet on the air
+	uint64_t nextEventNs() const;
+		// deliver every packet that ends at or before the current virtual time
+	void run();
+		// count a packet the driver handed to the application
+	void countReceived(const uint8_t *packet);
+
+	int indexOf(uint8_t id) const;
+	uint32_t frf(uint8_t channel) const;
+	uint8_t channels() const;
+
+private:
+	RFM69Model &rx;
+	RFM69Model *rx2;
+	uint8_t band;
+	SimRandom rnd;
+	SimRandom rnd2;			// draws for rx2
+	uint64_t nextTxNs[ISS_SIM_MAX_STATIONS];	// start of the next packet
+	uint64_t slotNs[ISS_SIM_MAX_STATIONS];		// ...and where it would be without jitter
+	uint64_t intervalNs[ISS_SIM_MAX_STATIONS];
+	uint8_t channel[ISS_SIM_MAX_STATIONS];
+	int16_t chanErr[ISS_SIM_MAX_STATIONS][ISS_SIM_MAX_CHANNELS];	// carrier offset per channel, Fstep
+	uint8_t seq[ISS_SIM_MAX_STATIONS];
+
+	void transmit(uint8_t i);
+	uint64_t jitter(uint8_t i, uint64_t slot);
+	uint32_t txFrf(uint8_t i) const;
+	int rssi(uint8_t i, SimRandom &r);
+	void buildPacket(uint8_t i, uint8_t *fifoBytes, SimRandom &r);
+	};
+
+#endif  // ISS_SIM_h
@@ -0,0 +1,148 @@
+// Register-level model of an RFM69 (SX1231) in the configuration used by DavisRFM69.
+
+#include <string.h>
+
+#include "RFM69Model.h"
+#include "RFM69registers.h"
+
+RFM69Model::RFM69Model(uint8_t csPin, uint8_t interruptNum) {
+	irqNum = interruptNum;
+	rxSettleNs = 200000;
+	preambleSlackNs = 1000000;
+	frfTolerance = 0;
+	reset();
+	board.attachSpiDevice(csPin, this);
+	}
+
+void RFM69Model::reset() {
+	memset(regs, 0, sizeof(regs));
+	regs[REG_OPMODE] = RF_OPMODE_SEQUENCER_ON | RF_OPMODE_LISTEN_OFF | RF_OPMODE_STANDBY;
+	regs[REG_FRFMSB] = 0xe4;
+	regs[REG_FRFMID] = 0xc0;
+	regs[REG_VERSION] = 0x24;
+	regs[REG_IRQFLAGS1] = RF_IRQFLAGS1_MODEREADY;
+	curFrf = 0xe4c000;
+	fifoHead = fifoLen = 0;
+	payloadReady = false;
+	lastChangeNs = board.nowNs;
+	first = false;
+	transactions = bytes = heard = overruns = 0;
+	}
+
+bool RFM69Model::hears(uint32_t txFrf, uint64_t startNs) const {
+	if (!inRx() || payloadReady) return false;
+	uint32_t err = txFrf > curFrf ? txFrf - curFrf : curFrf - txFrf;
+	if (err > captureRange()) return false;
+	return lastChangeNs + rxSettleNs <= startNs + preambleSlackNs;
+	}
+
+	// How far off its carrier the radio may be tuned: AFC corrects anything that keeps the
+	// whole signal (Carson bandwidth, 2 * 9.9 kHz deviation + 19.2 kbps) inside the AFC filter
+uint32_t RFM69Model::captureRange() const {
+	if (frfTolerance) return frfTolerance;
+	uint8_t bw = regs[REG_AFCBW];
+	double filterHz = 32e6 / ((16 + 4 * ((bw >> 3) & 3)) * (1 << ((bw & 7) + 2)));
+	double slackHz = (filterHz - 39000) / 2;
+	return slackHz > 0 ? (uint32_t) (slackHz / 61.03515625) : 0;
+	}
+
+void RFM69Model::receive(const uint8_t *fifoBytes, uint8_t len, int rssiDbm, int16_t fei) {
+	if (payloadReady) {
+		overruns++;
+		return;
+		}
+	clearFifo();
+	for (uint8_t i = 0; i < len && i < RFM69_MODEL_FIFO_SIZE; i++) fifo[fifoLen++] = fifoBytes[i];
+	regs[REG_RSSIVALUE] = (uint8_t) (-rssiDbm * 2);
+	regs[REG_FEIMSB] = (uint8_t) ((uint16_t) fei >> 8);
+	regs[REG_FEILSB] = (uint8_t) fei;
+	payloadReady = true;
+	heard++;
+	if ((regs[REG_DIOMAPPING1] & 0xc0) == RF_DIOMAPPING1_DIO0_01) board.raiseIrq(irqNum);
+	}
+
+void RFM69Model::select() {
+	transactions++;
+	first = true;
+	}
+
+void RFM69Model::unselect() {
+	first = false;
+	}
+
+uint8_t RFM69Model::transfer(uint8_t out) {
+	bytes++;
+	if (first) {
+		first = false;
+		writing = out & 0x80;
+		addr = out & 0x7f;
+		return 0;
+		}
+	uint8_t in = 0;
+	if (writing) writeReg(addr, out);
+	else in = readReg(addr);
+	if (addr != REG_FIFO) addr = (addr + 1) & 0x7f;		// FIFO access doesn't auto-increment
+	return in;
+	}
+
+uint8_t RFM69Model::readReg(uint8_t a) {
+	switch (a) {
+		case REG_FIFO: {
+			if (fifoLen == 0) return 0;
+			uint8_t v = fifo[fifoHead];
+			fifoHead = (fifoHead + 1) % RFM69_MODEL_FIFO_SIZE;
+			if (--fifoLen == 0) {
+				// PayloadReady clears once the FIFO is drained; with AutoRxRestartOn
+				// the receiver then restarts by itself
+				bool wasReady = payloadReady;
+				payloadReady = false;
+				if (wasReady && inRx() && (regs[REG_PACKETCONFIG2] & RF_PACKET2_AUTORXRESTART_ON)) restartRx();
+				}
+			return v;
+			}
+		case REG_IRQFLAGS1:
+			return RF_IRQFLAGS1_MODEREADY | (inRx() ? RF_IRQFLAGS1_RXREADY : 0);
+		case REG_IRQFLAGS2:
+			return (fifoLen ? RF_IRQFLAGS2_FIFONOTEMPTY : 0) | (payloadReady ? RF_IRQFLAGS2_PAYLOADREADY : 0);
+		default:
+			return regs[a];
+		}
+	}
+
+void RFM69Model::writeReg(uint8_t a, uint8_t v) {
+	switch (a) {
+		case REG_FIFO:
+			return;
+		case REG_OPMODE:
+			if (((v ^ regs[a]) >> 2) & 7) lastChangeNs = board.nowNs;
+			regs[a] = v;
+			if (opMode() == 0) clearFifo();
+			return;
+		case REG_FRFLSB:
+			regs[a] = v;
+			curFrf = ((uint32_t) regs[REG_FRFMSB] << 16) | ((uint32_t) regs[REG_FRFMID] << 8) | v;
+			lastChangeNs = board.nowNs;
+			return;
+		case REG_IRQFLAGS1:
+			return;
+		case REG_IRQFLAGS2:
+			if (v & RF_IRQFLAGS2_FIFOOVERRUN) clearFifo();
+			return;
+		case REG_PACKETCONFIG2:
+			regs[a] = v & ~RF_PACKET2_RXRESTART;
+			if (v & RF_PACKET2_RXRESTART) restartRx();
+			return;
+		default:
+			regs[a] = v;
+		}
+	}
+
+void RFM69Model::clearFifo() {
+	fifoHead = fifoLen = 0;
+	payloadReady = false;
+	}
+
+void RFM69Model::restartRx() {
+	clearFifo();
+	lastChangeNs = board.nowNs;
+	}
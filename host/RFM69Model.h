@@ -0,0 +1,69 @@
+// Register-level model of an RFM69 (SX1231) in the configuration used by DavisRFM69.
+//
+// Models SPI register access with address auto-increment, the 66 byte FIFO, OPMODE,
+// IRQFLAGS1/2, the FRF registers (latched on the LSB write as on the real chip), RSSI and
+// FEI, RX restart and DIO0 = PayloadReady. The air side is a single call: a packet is
+// heard if the receiver sat in RX for the whole packet, tuned close enough to its carrier
+// for the AFC to pull it in.
+
+#ifndef RFM69_MODEL_h
+#define RFM69_MODEL_h
+
+#include <stdint.h>
+
+#include "HostBoard.h"
+
+#define RFM69_MODEL_FIFO_SIZE 66
+
+class RFM69Model : public SpiDevice {
+public:
+	uint32_t rxSettleNs;		// time from entering RX / retuning until the demodulator is usable
+	uint32_t preambleSlackNs;	// how late into the preamble the receiver may still lock on
+	uint32_t frfTolerance;		// accepted |FRF error| in Fstep (61.035 Hz) units, 0: by REG_AFCBW
+
+	uint32_t transactions;		// SPI transactions (chip select cycles) seen
+	uint32_t bytes;				// SPI bytes seen, including address bytes
+	uint32_t heard;				// packets put in the FIFO
+	uint32_t overruns;			// packets lost because the last payload wasn't read yet
+
+	RFM69Model(uint8_t csPin, uint8_t interruptNum);
+	void reset();
+
+	uint8_t reg(uint8_t addr) const { return regs[addr & 0x7f]; }
+	uint8_t opMode() const { return (regs[0x01] >> 2) & 7; }
+	bool inRx() const { return opMode() == 4; }
+	uint32_t frf() const { return curFrf; }
+	uint64_t lastChange() const { return lastChangeNs; }
+	uint32_t captureRange() const;
+
+		// true when a packet on txFrf that started at startNs (and ends now) was received
+	bool hears(uint32_t txFrf, uint64_t startNs) const;
+		// put a received payload (bytes in FIFO order) in the FIFO and raise DIO0.
+		// rssiDbm is e.g. -80, fei is in Fstep units.
+	void receive(const uint8_t *fifoBytes, uint8_t len, int rssiDbm, int16_t fei);
+
+	// SpiDevice
+	void select();
+	uint8_t transfer(uint8_t out);
+	void unselect();
+
+private:
+	uint8_t irqNum;
+	uint8_t regs[0x80];
+	uint8_t fifo[RFM69_MODEL_FIFO_SIZE];
+	uint8_t fifoHead, fifoLen;
+	bool payloadReady;
+	uint32_t curFrf;
+	uint64_t lastChangeNs;
+
+	bool first;
+	bool writing;
+	uint8_t addr;
+
+	uint8_t readReg(uint8_t a);
+	void writeReg(uint8_t a, uint8_t v);
+	void clearFifo();
+	void restartRx();
+	};
+
+#endif  // RFM69_MODEL_h
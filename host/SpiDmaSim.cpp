@@ -0,0 +1,31 @@
+// Simulated DMAC for host builds: implements DavisRFM69_dma.h on top of HostBoard.
+//
+// A transfer occupies the bus for len * spiByteNs of virtual time. The bytes are exchanged
+// with the selected device when it completes, then the "DMA complete" interrupt calls back.
+
+#include <Arduino.h>
+#include "DavisRFM69_dma.h"
+#include "HostBoard.h"
+
+static const byte *dmaTx;
+static byte *dmaRx;
+static uint16_t dmaLen;
+static void (*doneCallback)();
+
+static void dmacIsr() {
+	for (uint16_t i = 0; i < dmaLen; i++) dmaRx[i] = board.spiExchange(dmaTx[i]);
+	board.spiBytes += dmaLen;
+	if (doneCallback) doneCallback();
+	}
+
+void spiDmaBegin() {
+	board.attach(HOST_IRQ_DMAC, dmacIsr);
+	}
+
+void spiDmaTransfer(const byte *tx, byte *rx, uint16_t len, void (*done)()) {
+	dmaTx = tx;
+	dmaRx = rx;
+	dmaLen = len;
+	doneCallback = done;
+	board.schedule(HOST_IRQ_DMAC, board.nowNs + (uint64_t) len * board.spiByteNs);
+	}
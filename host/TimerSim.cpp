@@ -0,0 +1,27 @@
+// Simulated tune-in timer for host builds: implements DavisRFM69_timer.h on top of HostBoard.
+
+#include <Arduino.h>
+#include "DavisRFM69_timer.h"
+#include "HostBoard.h"
+
+static void (*fireCallback)();
+
+static void timerIsr() {
+	if (fireCallback) fireCallback();
+	}
+
+void tuneTimerBegin(void (*fire)()) {
+	fireCallback = fire;
+	board.attach(HOST_IRQ_TIMER, timerIsr);
+	}
+
+void tuneTimerArm(uint32_t at) {
+	// micros() wraps every 71 minutes, the board clock doesn't
+	int32_t us = at - micros();
+	if (us < 0) us = 0;
+	board.schedule(HOST_IRQ_TIMER, board.nowNs + (uint64_t) us * 1000);
+	}
+
+void tuneTimerCancel() {
+	board.cancel(HOST_IRQ_TIMER);
+	}
@@ -0,0 +1,460 @@
+// Turns receiver serial streams into a columnar time-series file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "WxIngest.h"
+
+	// COBS bytes of the longest record a frame may hold, and its closing 0
+#define FRAME_WINDOW		(WXREC_MAX_SIZE + 2 + 1 + 1)
+
+ColumnTable::ColumnTable(uint8_t id, const char *name) : id(id), name(name), totalRows(0), columns(0), rows(0) {}
+
+ColumnTable::~ColumnTable() {
+	for (uint8_t c = 0; c < columns; c++) free(data[c]);
+	}
+
+void ColumnTable::addColumn(const char *name, const char *type, uint8_t w) {
+	if (columns >= COLUMN_MAX) return;
+	colName[columns] = name;
+	colType[columns] = type;
+	width[columns] = w;
+	data[columns] = (uint8_t *) malloc((size_t) COLUMN_BLOCK_ROWS * w);
+	columns++;
+	}
+
+void ColumnTable::writeSchema(FILE *out) const {
+	fprintf(out, "table %u %s %u\n", id, name, columns);
+	for (uint8_t c = 0; c < columns; c++) fprintf(out, "%s %s\n", colName[c], colType[c]);
+	}
+
+void ColumnTable::flush(FILE *out) {
+	if (rows == 0) return;
+	uint8_t head[5] = { id, (uint8_t) rows, (uint8_t) (rows >> 8), (uint8_t) (rows >> 16), (uint8_t) (rows >> 24) };
+	fwrite(head, 1, sizeof(head), out);
+	for (uint8_t c = 0; c < columns; c++) fwrite(data[c], width[c], rows, out);
+	totalRows += rows;
+	rows = 0;
+	}
+
+	// the values are stored little endian, as the hosts this runs on are
+template <typename T> static inline void put(ColumnTable &t, uint8_t col, T v) {
+	memcpy(t.cell(col), &v, sizeof(v));
+	}
+
+	// Column indexes
+enum { WX_TIME, WX_STATION, WX_TYPE, WX_FLAGS, WX_RSSI, WX_PACKETS, WX_LOST, WX_RAIN, WX_RAINRATE, WX_RH,
+	WX_SOILLEAF, WX_SOLAR, WX_TEMP, WX_UV, WX_VCAP, WX_VSOLAR, WX_WINDD, WX_WINDDRAW, WX_WINDGUST,
+	WX_WINDGUSTD, WX_WINDV };
+enum { BME_TIME, BME_TEMP, BME_PRESSURE, BME_HUMIDITY };
+enum { RAW_TIME, RAW_STATION, RAW_CHANNEL, RAW_RSSI, RAW_PACKET };
+enum { SUM_TIME, SUM_STATION, SUM_FLAGS, SUM_COUNT, SUM_SECONDS, SUM_RSSI, SUM_PACKETS, SUM_LOST, SUM_WINDAVG,
+	SUM_WINDMIN, SUM_WINDMAX, SUM_WINDD, SUM_WINDGUST, SUM_WINDGUSTD, SUM_TEMP, SUM_TEMPMIN, SUM_TEMPMAX, SUM_RH,
+	SUM_RAIN, SUM_RAINRATE, SUM_SOLAR, SUM_UV, SUM_VCAP, SUM_VSOLAR, SUM_SOILLEAF };
+
+#define STATION_UNKNOWN		0xff	// wx.station and wx.type of a "c:" line, which doesn't say
+#define RAW_PACKET_LEN		10
+
+WxIngest::WxIngest(FILE *out) : liveTime(false), out(out), wx(1, "wx"), bme(2, "bme"), raw(3, "raw"), summary(4, "summary"),
+	timeMs(0), afterZero(false), carryLen(0), skipping(false) {
+	memset(&stats, 0, sizeof(stats));
+	wx.addColumn("time_ms", "i64", 8);
+	wx.addColumn("station", "u8", 1);
+	wx.addColumn("type", "u8", 1);
+	wx.addColumn("flags", "u8", 1);
+	wx.addColumn("rssi", "u8", 1);
+	wx.addColumn("packets", "u32", 4);
+	wx.addColumn("lost", "u32", 4);
+	wx.addColumn("rain", "u8", 1);
+	wx.addColumn("rainrate", "u16", 2);
+	wx.addColumn("rh", "u16", 2);
+	wx.addColumn("soilleaf", "i16", 2);
+	wx.addColumn("solar", "i16", 2);
+	wx.addColumn("temp", "i16", 2);
+	wx.addColumn("uv", "i16", 2);
+	wx.addColumn("vcap", "i16", 2);
+	wx.addColumn("vsolar", "i16", 2);
+	wx.addColumn("windd", "u16", 2);
+	wx.addColumn("winddraw", "u8", 1);
+	wx.addColumn("windgust", "u8", 1);
+	wx.addColumn("windgustd", "u8", 1);
+	wx.addColumn("windv", "u16", 2);
+	bme.addColumn("time_ms", "i64", 8);
+	bme.addColumn("temp", "f32", 4);
+	bme.addColumn("pressure", "f32", 4);
+	bme.addColumn("humidity", "f32", 4);
+	raw.addColumn("time_ms", "i64", 8);
+	raw.addColumn("station", "u8", 1);
+	raw.addColumn("channel", "u8", 1);
+	raw.addColumn("rssi", "u8", 1);
+	raw.addColumn("packet", "u8x10", 10);
+	summary.addColumn("time_ms", "i64", 8);
+	summary.addColumn("station", "u8", 1);
+	summary.addColumn("flags", "u8", 1);
+	summary.addColumn("count", "u8", 1);
+	summary.addColumn("seconds", "u16", 2);
+	summary.addColumn("rssi", "u8", 1);
+	summary.addColumn("packets", "u32", 4);
+	summary.addColumn("lost", "u32", 4);
+	summary.addColumn("wind_avg", "u16", 2);
+	summary.addColumn("wind_min", "u8", 1);
+	summary.addColumn("wind_max", "u8", 1);
+	summary.addColumn("windd", "u16", 2);
+	summary.addColumn("windgust", "u8", 1);
+	summary.addColumn("windgustd", "u8", 1);
+	summary.addColumn("temp", "i16", 2);
+	summary.addColumn("temp_min", "i16", 2);
+	summary.addColumn("temp_max", "i16", 2);
+	summary.addColumn("rh", "u16", 2);
+	summary.addColumn("rain", "u8", 1);
+	summary.addColumn("rainrate", "u16", 2);
+	summary.addColumn("solar", "i16", 2);
+	summary.addColumn("uv", "i16", 2);
+	summary.addColumn("vcap", "i16", 2);
+	summary.addColumn("vsolar", "i16", 2);
+	summary.addColumn("soilleaf", "i16", 2);
+	fputs("WXCOL1\n", out);
+	wx.writeSchema(out);
+	bme.writeSchema(out);
+	raw.writeSchema(out);
+	summary.writeSchema(out);
+	fputs("\n", out);
+	}
+
+WxIngest::~WxIngest() {}
+
+void WxIngest::feed(const uint8_t *data, size_t len) {
+	stats.bytes += len;
+	if (liveTime) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		timeMs = (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+		}
+	// finish the token the last chunk ended in, a piece of this one at a time
+	while (carryLen > 0 && len > 0) {
+		size_t k = len < sizeof(carry) - carryLen ? len : sizeof(carry) - carryLen;
+		memcpy(carry + carryLen, data, k);
+		size_t old = carryLen;
+		carryLen += k;
+		size_t n = scan(carry, carryLen, false);
+		if (n >= old) {
+			// done with what was carried; the rest is still in data
+			data += n - old;
+			len -= n - old;
+			carryLen = 0;
+			break;
+			}
+		memmove(carry, carry + n, carryLen - n);
+		carryLen -= n;
+		data += k;
+		len -= k;
+		if (carryLen == sizeof(carry)) {
+			stats.bad++;
+			carryLen = 0;
+			skipping = true;
+			}
+		}
+	if (len == 0) return;
+	size_t n = scan(data, len, false);
+	if (len - n > sizeof(carry)) {
+		stats.bad++;
+		skipping = true;
+		}
+	else {
+		memcpy(carry, data + n, len - n);
+		carryLen = len - n;
+		}
+	}
+
+void WxIngest::finish() {
+	if (carryLen > 0) scan(carry, carryLen, true);
+	carryLen = 0;
+	wx.flush(out);
+	bme.flush(out);
+	raw.flush(out);
+	summary.flush(out);
+	fflush(out);
+	}
+
+	// Tokenize p: frames after a 0, text lines otherwise. Returns how much of it was used;
+	// unless final, a token that may go on past the end is left for the next call.
+size_t WxIngest::scan(const uint8_t *p, size_t len, bool final) {
+	const uint8_t *s = p, *end = p + len;
+	while (s < end) {
+		if (skipping) {
+			// the rest of an overlong line
+			const uint8_t *nl = (const uint8_t *) memchr(s, '\n', end - s);
+			const uint8_t *z = (const uint8_t *) memchr(s, 0, (nl ? nl : end) - s);
+			if (z) s = z;
+			else if (nl) s = nl + 1;
+			else return len;
+			skipping = false;
+			continue;
+			}
+		if (*s == 0) {
+			afterZero = true;
+			s++;
+			continue;
+			}
+		if (afterZero) {
+			size_t window = end - s < FRAME_WINDOW ? end - s : FRAME_WINDOW;
+			const uint8_t *z = (const uint8_t *) memchr(s, 0, window);
+			if (z) {
+				WxRecord r;
+				WxSummary sum;
+				int status = dec.decodeFrame(s, z - s, &r, &sum);
+				if (status == WXDEC_OK) frame(r);
+				else if (status == WXDEC_SUMMARY) summaryFrame(sum);
+				else if (status == WXDEC_NOKEY) stats.unkeyed++;
+				if (status == WXDEC_OK || status == WXDEC_SUMMARY || status == WXDEC_NOKEY) {
+					s = z;
+					continue;
+					}
+				}
+			else if (!final && window < FRAME_WINDOW) break;
+			afterZero = false;	// text, or a frame too damaged to tell from it
+			}
+		// a line, up to its '\n' or the 0 a frame starts with
+		const uint8_t *nl = (const uint8_t *) memchr(s, '\n', end - s);
+		const uint8_t *e = nl ? nl : end;
+		const uint8_t *z = (const uint8_t *) memchr(s, 0, e - s);
+		if (z) e = z;
+		else if (!nl && !final) break;
+		line((const char *) s, (const char *) e);
+		s = e < end && *e == '\n' ? e + 1 : e;
+		}
+	return s - p;
+	}
+
+	// [-]digits, into v
+static bool parseInt(const char *&p, const char *end, int64_t *v) {
+	bool neg = p < end && *p == '-';
+	if (neg) p++;
+	const char *start = p;
+	int64_t n = 0;
+	while (p < end && (unsigned) (*p - '0') < 10) n = n * 10 + (*p++ - '0');
+	*v = neg ? -n : n;
+	return p > start;
+	}
+
+	// [-]digits[.digits], into v
+static bool parseDec(const char *&p, const char *end, double *v) {
+	bool neg = p < end && *p == '-';
+	if (neg) p++;
+	const char *start = p;
+	int64_t n = 0;
+	while (p < end && (unsigned) (*p - '0') < 10) n = n * 10 + (*p++ - '0');
+	double d = (double) n;
+	if (p < end && *p == '.') {
+		double scale = 1;
+		n = 0;
+		for (p++; p < end && (unsigned) (*p - '0') < 10; p++) {
+			n = n * 10 + (*p - '0');
+			scale *= 10;
+			}
+		d += n / scale;
+		}
+	*v = neg ? -d : d;
+	return p > start;
+	}
+
+static bool expect(const char *&p, const char *end, char c) {
+	if (p < end && *p == c) {
+		p++;
+		return true;
+		}
+	return false;
+	}
+
+static int16_t fixedOf(double v, int scale) {
+	return v < 0 ? WXREC_NONE : (int16_t) (v * scale + 0.5);
+	}
+
+void WxIngest::line(const char *p, const char *end) {
+	if (end > p && end[-1] == '\r') end--;
+	if (end == p) return;
+	stats.lines++;
+
+	// an optional timestamp prefix, "SECONDS[.FRAC] " or "[SECONDS[.FRAC]] "
+	if ((unsigned) (*p - '0') < 10 || *p == '[') {
+		const char *q = p;
+		bool bracket = expect(q, end, '[');
+		double secs;
+		if (parseDec(q, end, &secs) && (!bracket || expect(q, end, ']')) && expect(q, end, ' ')) {
+			timeMs = (int64_t) (secs * 1000 + 0.5);
+			p = q;
+			}
+		}
+
+	bool ok = true;
+	if (end - p >= 2 && p[0] == 'c' && p[1] == ':') {
+		stats.csv++;
+		ok = csvLine(p + 2, end);
+		}
+	else if (end - p >= 2 && p[0] == 't' && p[1] == ':') stats.trace++;
+	else if (end - p >= 4 && !memcmp(p, "bme:", 4)) {
+		stats.bme++;
+		ok = bmeLine(p + 4, end);
+		}
+	else if (end - p >= 4 && !memcmp(p, "raw:", 4)) {
+		stats.raw++;
+		ok = rawLine(p + 4, end);
+		}
+	else stats.other++;
+	if (!ok) stats.bad++;
+	}
+
+void WxIngest::frame(const WxRecord &r) {
+	stats.frames++;
+	put<int64_t>(wx, WX_TIME, timeMs);
+	put<uint8_t>(wx, WX_STATION, r.station);
+	put<uint8_t>(wx, WX_TYPE, r.type);
+	put<uint8_t>(wx, WX_FLAGS, r.flags);
+	put<uint8_t>(wx, WX_RSSI, r.rssi);
+	put<uint32_t>(wx, WX_PACKETS, r.packets);
+	put<uint32_t>(wx, WX_LOST, r.lostPackets);
+	put<uint8_t>(wx, WX_RAIN, r.rain);
+	put<uint16_t>(wx, WX_RAINRATE, r.rainrate);
+	put<uint16_t>(wx, WX_RH, r.rh);
+	put<int16_t>(wx, WX_SOILLEAF, r.soilleaf);
+	put<int16_t>(wx, WX_SOLAR, r.solar);
+	put<int16_t>(wx, WX_TEMP, r.temp);
+	put<int16_t>(wx, WX_UV, r.uv);
+	put<int16_t>(wx, WX_VCAP, r.vcap);
+	put<int16_t>(wx, WX_VSOLAR, r.vsolar);
+	put<uint16_t>(wx, WX_WINDD, r.windd);
+	put<uint8_t>(wx, WX_WINDDRAW, r.winddraw);
+	put<uint8_t>(wx, WX_WINDGUST, r.windgust);
+	put<uint8_t>(wx, WX_WINDGUSTD, r.windgustd);
+	put<uint16_t>(wx, WX_WINDV, r.windv);
+	wx.endRow(out);
+	}
+
+void WxIngest::summaryFrame(const WxSummary &s) {
+	stats.summaries++;
+	put<int64_t>(summary, SUM_TIME, timeMs);
+	put<uint8_t>(summary, SUM_STATION, s.station);
+	put<uint8_t>(summary, SUM_FLAGS, s.flags);
+	put<uint8_t>(summary, SUM_COUNT, s.count);
+	put<uint16_t>(summary, SUM_SECONDS, s.seconds);
+	put<uint8_t>(summary, SUM_RSSI, s.rssi);
+	put<uint32_t>(summary, SUM_PACKETS, s.packets);
+	put<uint32_t>(summary, SUM_LOST, s.lostPackets);
+	put<uint16_t>(summary, SUM_WINDAVG, s.windAvg);
+	put<uint8_t>(summary, SUM_WINDMIN, s.windMin);
+	put<uint8_t>(summary, SUM_WINDMAX, s.windMax);
+	put<uint16_t>(summary, SUM_WINDD, s.windd);
+	put<uint8_t>(summary, SUM_WINDGUST, s.windgust);
+	put<uint8_t>(summary, SUM_WINDGUSTD, s.windgustd);
+	put<int16_t>(summary, SUM_TEMP, s.temp);
+	put<int16_t>(summary, SUM_TEMPMIN, s.tempMin);
+	put<int16_t>(summary, SUM_TEMPMAX, s.tempMax);
+	put<uint16_t>(summary, SUM_RH, s.rh);
+	put<uint8_t>(summary, SUM_RAIN, s.rain);
+	put<uint16_t>(summary, SUM_RAINRATE, s.rainrate);
+	put<int16_t>(summary, SUM_SOLAR, s.solar);
+	put<int16_t>(summary, SUM_UV, s.uv);
+	put<int16_t>(summary, SUM_VCAP, s.vcap);
+	put<int16_t>(summary, SUM_VSOLAR, s.vsolar);
+	put<int16_t>(summary, SUM_SOILLEAF, s.soilleaf);
+	summary.endRow(out);
+	}
+
+	// c:TOTAL,PCT,RSSI,ok|err,RAIN,RAINRATE,RH,SOLAR,TEMP,UV,VCAP,VSOLAR,WINDD,WINDDRAW,WINDGUST,WINDGUSTD,WINDV
+bool WxIngest::csvLine(const char *p, const char *end) {
+	int64_t total, rssi, n[13];
+	double pct, solar, uv;
+	if (!parseInt(p, end, &total) || !expect(p, end, ',') || !parseDec(p, end, &pct) || !expect(p, end, ',')
+		|| !parseInt(p, end, &rssi) || !expect(p, end, ',')) return false;
+	bool battLow = end - p >= 3 && !memcmp(p, "err", 3);
+	if (!battLow && !(end - p >= 2 && !memcmp(p, "ok", 2))) return false;
+	p += battLow ? 3 : 2;
+	for (int i = 0; i < 13; i++) {
+		if (!expect(p, end, ',')) return false;
+		bool ok;
+		if (i == 3) ok = parseDec(p, end, &solar);
+		else if (i == 5) ok = parseDec(p, end, &uv);
+		else ok = parseInt(p, end, &n[i]);
+		if (!ok) return false;
+		}
+	uint32_t packets = (uint32_t) (total * pct / 100 + 0.5);
+	put<int64_t>(wx, WX_TIME, timeMs);
+	put<uint8_t>(wx, WX_STATION, STATION_UNKNOWN);
+	put<uint8_t>(wx, WX_TYPE, STATION_UNKNOWN);
+	put<uint8_t>(wx, WX_FLAGS, battLow ? WXREC_BATT_LOW : 0);
+	put<uint8_t>(wx, WX_RSSI, (uint8_t) (rssi < 0 ? -rssi : rssi));	// printed as dBm
+	put<uint32_t>(wx, WX_PACKETS, packets);
+	put<uint32_t>(wx, WX_LOST, (uint32_t) total - packets);
+	put<uint8_t>(wx, WX_RAIN, (uint8_t) n[0]);
+	put<uint16_t>(wx, WX_RAINRATE, (uint16_t) n[1]);
+	put<uint16_t>(wx, WX_RH, (uint16_t) n[2]);
+	put<int16_t>(wx, WX_SOILLEAF, WXREC_NONE);
+	put<int16_t>(wx, WX_SOLAR, fixedOf(solar, 10));
+	put<int16_t>(wx, WX_TEMP, (int16_t) n[4]);
+	put<int16_t>(wx, WX_UV, fixedOf(uv, 100));
+	put<int16_t>(wx, WX_VCAP, (int16_t) n[6]);
+	put<int16_t>(wx, WX_VSOLAR, (int16_t) n[7]);
+	put<uint16_t>(wx, WX_WINDD, (uint16_t) n[8]);
+	put<uint8_t>(wx, WX_WINDDRAW, (uint8_t) n[9]);
+	put<uint8_t>(wx, WX_WINDGUST, (uint8_t) n[10]);
+	put<uint8_t>(wx, WX_WINDGUSTD, (uint8_t) n[11]);
+	put<uint16_t>(wx, WX_WINDV, (uint16_t) n[12]);
+	wx.endRow(out);
+	return true;
+	}
+
+	// bme:TEMP,PRESSURE,HUMIDITY
+bool WxIngest::bmeLine(const char *p, const char *end) {
+	double v[3];
+	for (int i = 0; i < 3; i++)
+		if ((i > 0 && !expect(p, end, ',')) || !parseDec(p, end, &v[i])) return false;
+	put<int64_t>(bme, BME_TIME, timeMs);
+	put<float>(bme, BME_TEMP, (float) v[0]);
+	put<float>(bme, BME_PRESSURE, (float) v[1]);
+	put<float>(bme, BME_HUMIDITY, (float) v[2]);
+	bme.endRow(out);
+	return true;
+	}
+
+static int hexDigit(char c) {
+	if ((unsigned) (c - '0') < 10) return c - '0';
+	if ((unsigned) (c - 'A') < 6) return c - 'A' + 10;
+	if ((unsigned) (c - 'a') < 6) return c - 'a' + 10;
+	return -1;
+	}
+
+	// raw:HH-HH-...-HH, station:N, ..., channel:N, rssi:-N, ...
+bool WxIngest::rawLine(const char *p, const char *end) {
+	uint8_t packet[RAW_PACKET_LEN];
+	for (int i = 0; i < RAW_PACKET_LEN; i++) {
+		if ((i > 0 && !expect(p, end, '-')) || end - p < 2) return false;
+		int hi = hexDigit(p[0]), lo = hexDigit(p[1]);
+		if (hi < 0 || lo < 0) return false;
+		packet[i] = hi << 4 | lo;
+		p += 2;
+		}
+	int64_t station = packet[0] & 7, channel = 0, rssi = 0;
+	while (p < end) {
+		// ", key:value"
+		if (!expect(p, end, ',') || !expect(p, end, ' ')) break;
+		const char *key = p;
+		const char *colon = (const char *) memchr(p, ':', end - p);
+		if (colon == NULL) break;
+		p = colon + 1;
+		size_t keyLen = colon - key;
+		int64_t v;
+		if (keyLen == 7 && !memcmp(key, "station", 7) && parseInt(p, end, &v)) station = v;
+		else if (keyLen == 7 && !memcmp(key, "channel", 7) && parseInt(p, end, &v)) channel = v;
+		else if (keyLen == 4 && !memcmp(key, "rssi", 4) && parseInt(p, end, &v)) rssi = -v;
+		const char *comma = (const char *) memchr(p, ',', end - p);
+		p = comma ? comma : end;
+		}
+	put<int64_t>(raw, RAW_TIME, timeMs);
+	put<uint8_t>(raw, RAW_STATION, (uint8_t) station);
+	put<uint8_t>(raw, RAW_CHANNEL, (uint8_t) channel);
+	put<uint8_t>(raw, RAW_RSSI, (uint8_t) rssi);
+	memcpy(raw.cell(RAW_PACKET), packet, RAW_PACKET_LEN);
+	raw.endRow(out);
+	return true;
+	}
@@ -0,0 +1,109 @@
+// Turns receiver serial streams into a columnar time-series file.
+//
+// The stream is whatever the sketch writes: binary records (DavisRFM69_record.h) between
+// 0 bytes, full, delta or summary ones, "c:" CSV lines (CSV_OUTPUT), "bme:" lines, the "raw:" lines of a
+// DAVISRFM69_DEBUG build and its "t:" trace lines, all mixed. WxIngest::feed() takes it
+// in chunks of any size and tokenizes it in place: lines and frames are parsed where
+// they lie in the caller's buffer, and only a token cut by the end of a chunk is copied,
+// to be finished with the next one.
+//
+// A line may start with a timestamp, seconds since the epoch as written by e.g.
+// `ts %.s` ("1697040000.123 c:..." or "[1697040000.123] c:..."); rows get the last one
+// seen. Without one, rows get the time the chunk was fed if liveTime is set (reading a
+// device), else the last timestamp, 0 before any.
+//
+// Column file: "WXCOL1\n", then the schema as text, one "table ID NAME COLUMNS" line per
+// table followed by a "NAME TYPE" line per column, ending with an empty line; then
+// blocks of up to COLUMN_BLOCK_ROWS rows of one table: table ID (u8), row count (u32),
+// then each column's values for those rows, one column after the other. Values are
+// little endian; types are i64 u32 u16 i16 u8 f32, and u8xN for N bytes.
+
+#ifndef WX_INGEST_h
+#define WX_INGEST_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "DavisRFM69_record.h"
+#include "WxRecordDecoder.h"
+
+#define COLUMN_BLOCK_ROWS	65536
+#define COLUMN_MAX			32
+#define INGEST_MAX_LINE		4096	// longer lines are dropped as bad
+
+	// One table of a column file: rows are buffered by column and written a block at a time
+class ColumnTable {
+public:
+	ColumnTable(uint8_t id, const char *name);
+	~ColumnTable();
+
+	void addColumn(const char *name, const char *type, uint8_t width);
+		// write the values of the current row column by column, then endRow()
+	uint8_t *cell(uint8_t col) { return data[col] + (size_t) rows * width[col]; }
+	void endRow(FILE *out) { if (++rows == COLUMN_BLOCK_ROWS) flush(out); }
+	void flush(FILE *out);
+	void writeSchema(FILE *out) const;
+
+	uint8_t id;
+	const char *name;
+	uint64_t totalRows;
+
+private:
+	uint8_t columns;
+	const char *colName[COLUMN_MAX];
+	const char *colType[COLUMN_MAX];
+	uint8_t width[COLUMN_MAX];
+	uint8_t *data[COLUMN_MAX];
+	uint32_t rows;
+	};
+
+struct IngestStats {
+	uint64_t bytes;
+	uint64_t lines;			// text lines, of any kind
+	uint64_t csv;			// "c:" lines
+	uint64_t bme;
+	uint64_t raw;
+	uint64_t trace;			// "t:" lines, counted only
+	uint64_t frames;		// binary records, full or delta
+	uint64_t unkeyed;		// delta records dropped: no full record of their station yet
+	uint64_t summaries;		// summary records
+	uint64_t other;			// lines of no known kind
+	uint64_t bad;			// known lines that didn't parse, and overlong lines
+	};
+
+class WxIngest {
+public:
+	IngestStats stats;
+	bool liveTime;			// stamp rows with the time they were fed
+
+	explicit WxIngest(FILE *out);
+	~WxIngest();
+
+		// Take the next len bytes of the stream
+	void feed(const uint8_t *data, size_t len);
+		// End of the stream: parse what is left and write the last blocks
+	void finish();
+		// records that came as delta records
+	uint64_t deltas() const { return dec.deltas; }
+
+private:
+	FILE *out;
+	ColumnTable wx, bme, raw, summary;
+	WxRecordDecoder dec;
+	int64_t timeMs;			// for the rows of the current line
+	bool afterZero;			// the last byte scanned was a 0: a frame may start here
+	uint8_t carry[INGEST_MAX_LINE];	// the unfinished token at the end of the last chunk
+	size_t carryLen;
+	bool skipping;			// dropping the rest of an overlong line
+
+	size_t scan(const uint8_t *p, size_t len, bool final);
+	void line(const char *p, const char *end);
+	void frame(const WxRecord &r);
+	void summaryFrame(const WxSummary &s);
+	bool csvLine(const char *p, const char *end);
+	bool bmeLine(const char *p, const char *end);
+	bool rawLine(const char *p, const char *end);
+	};
+
+#endif  // WX_INGEST_h
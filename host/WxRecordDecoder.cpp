@@ -0,0 +1,130 @@
+// Reads the sketch's binary weather records (DavisRFM69_record.h) out of a serial stream.
+
+#include <string.h>
+
+#include "WxRecordDecoder.h"
+
+static uint16_t crcTab[256];
+
+static void crcInit() {
+	if (crcTab[1]) return;
+	for (int n = 0; n < 256; n++) {
+		uint16_t crc = n << 8;
+		for (int i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		crcTab[n] = crc;
+		}
+	}
+
+uint16_t WxRecordDecoder::crc16(const uint8_t *buf, size_t len, uint16_t crc) {
+	while (len--) crc = (crc << 8) ^ crcTab[(crc >> 8) ^ *buf++];
+	return crc;
+	}
+
+WxRecordDecoder::WxRecordDecoder() : records(0), newer(0), deltas(0), summaries(0), pendingLen(0), pendingLong(false), keyed(0) {
+	memset(errors, 0, sizeof(errors));
+	memset(seq, 0, sizeof(seq));
+	crcInit();
+	}
+
+int WxRecordDecoder::decodeFrame(const uint8_t *cobs, size_t len, WxRecord *r, WxSummary *s) {
+	uint8_t buf[WXREC_MAX_SIZE + 2];
+	if (len < WXREC_DELTA_HEAD + 3 || len > sizeof(buf) + sizeof(buf) / 254 + 1) return WXDEC_LENGTH;
+	int n = cobsDecode(cobs, len, buf);
+	if (n < 0) return WXDEC_COBS;
+	if (n < WXREC_DELTA_HEAD + 2) return WXDEC_LENGTH;
+	// the CRC is stored big endian after the record, so over both it comes out 0
+	if (crc16(buf, n) != 0) return WXDEC_CRC;
+	if (buf[0] == 0) return WXDEC_VERSION;
+	size_t recLen = n - 2;
+	if (buf[0] & WXREC_DELTA) return applyDelta(buf, recLen, r);
+	if (buf[0] == WXREC_SUMMARY) {
+		if (recLen < sizeof(WxSummary)) return WXDEC_LENGTH;
+		memcpy(s, buf, sizeof(WxSummary));
+		summaries++;
+		return WXDEC_SUMMARY;
+		}
+	if (recLen < WXREC_V1_SIZE) return WXDEC_LENGTH;
+	if (recLen >= sizeof(WxRecord)) memcpy(r, buf, sizeof(WxRecord));
+	else {
+		memcpy(r, buf, recLen);
+		memset((uint8_t *) r + recLen, 0, sizeof(WxRecord) - recLen);
+		}
+	last[r->station & 7] = *r;
+	keyed |= 1 << (r->station & 7);
+	seq[r->station & 7] = 0;
+	return WXDEC_OK;
+	}
+
+int WxRecordDecoder::applyDelta(const uint8_t *buf, size_t len, WxRecord *r) {
+	uint8_t st = buf[0] & 7;
+	if (!(keyed >> st & 1)) return WXDEC_NOKEY;
+	// a delta record of the station went missing: last is out of date until its next full one
+	if (buf[3] != (uint8_t) (seq[st] + 1)) {
+		keyed &= ~(1 << st);
+		return WXDEC_NOKEY;
+		}
+	WxRecord next = last[st];
+	next.type = buf[0] >> 3 & 0xf;
+	next.rssi = buf[1];
+	next.packets += (uint8_t) (buf[2] - next.packets);
+	uint16_t mask = buf[4] | buf[5] << 8;
+	const uint8_t *p = buf + WXREC_DELTA_HEAD, *end = buf + len;
+	for (uint8_t i = 0; i < WXREC_FIELDS; i++) {
+		if (!(mask >> i & 1)) continue;
+		const WxRecordField &fd = wxRecordFields[i];
+		if (end - p < fd.size) return WXDEC_LENGTH;
+		if (i == WXREC_F_LOST) next.lostPackets += (uint8_t) (*p - next.lostPackets);
+		else memcpy((uint8_t *) &next + fd.offset, p, fd.size);
+		p += fd.size;
+		}
+	if (p != end) return WXDEC_LENGTH;
+	last[st] = next;
+	seq[st] = buf[3];
+	*r = next;
+	deltas++;
+	return WXDEC_OK;
+	}
+
+void WxRecordDecoder::frameDone(const uint8_t *cobs, size_t len, Handler onRecord, void *ctx,
+	SummaryHandler onSummary) {
+	if (len == 0) return;	// back to back delimiters
+	WxRecord r;
+	WxSummary s;
+	int status = decodeFrame(cobs, len, &r, &s);
+	if (status == WXDEC_SUMMARY) {
+		if (onSummary) onSummary(s, ctx);
+		return;
+		}
+	if (status != WXDEC_OK) {
+		errors[status]++;
+		return;
+		}
+	records++;
+	if (r.version > WXREC_VERSION) newer++;
+	onRecord(r, ctx);
+	}
+
+void WxRecordDecoder::feed(const uint8_t *data, size_t len, Handler onRecord, void *ctx, SummaryHandler onSummary) {
+	const uint8_t *end = data + len;
+	while (data < end) {
+		const uint8_t *zero = (const uint8_t *) memchr(data, 0, end - data);
+		const uint8_t *stop = zero ? zero : end;
+		size_t n = stop - data;
+		if (pendingLen == 0 && !pendingLong && zero) frameDone(data, n, onRecord, ctx, onSummary);
+		else {
+			// carry the frame over to the next chunk, or finish one carried over
+			if (pendingLen + n > sizeof(pending)) pendingLong = true;
+			else {
+				memcpy(pending + pendingLen, data, n);
+				pendingLen += n;
+				}
+			if (zero) {
+				if (pendingLong) errors[WXDEC_LENGTH]++;
+				else frameDone(pending, pendingLen, onRecord, ctx, onSummary);
+				pendingLen = 0;
+				pendingLong = false;
+				}
+			}
+		data = zero ? zero + 1 : end;
+		}
+	}
@@ -0,0 +1,67 @@
+// Reads the sketch's binary weather records (DavisRFM69_record.h) out of a serial stream.
+//
+// Standalone: it needs neither the driver nor the simulated board, only the record
+// format header. Feed it the stream in chunks of any size; each good record is handed to
+// the callback as it completes. Frames are found with memchr() on the 0 delimiters, and
+// decoded straight out of the caller's buffer unless they straddle two chunks. Delta
+// records are applied to the station's last record and handed out whole, once a full
+// record of the station came in to apply them to. Summary records of batched output go
+// to their own callback, if there is one.
+//
+//   WxRecordDecoder dec;
+//   while ((n = read(fd, buf, sizeof(buf))) > 0) dec.feed(buf, n, onRecord, ctx);
+
+#ifndef WX_RECORD_DECODER_h
+#define WX_RECORD_DECODER_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DavisRFM69_record.h"
+
+	// frame status from WxRecordDecoder::decodeFrame()
+#define WXDEC_OK			0
+#define WXDEC_COBS			1	// not valid COBS: text, or the frame was cut
+#define WXDEC_LENGTH		2	// too short or too long for any record version
+#define WXDEC_CRC			3
+#define WXDEC_VERSION		4	// version 0
+#define WXDEC_NOKEY			5	// a delta record of a station not yet seen in full, or since one went missing
+#define WXDEC_STATUSES		6
+#define WXDEC_SUMMARY		(-1)	// not an error: a summary record
+
+class WxRecordDecoder {
+public:
+	typedef void (*Handler)(const WxRecord &r, void *ctx);
+	typedef void (*SummaryHandler)(const WxSummary &s, void *ctx);
+
+	uint64_t records;		// good records handed out
+	uint64_t errors[WXDEC_STATUSES];	// chunks between delimiters rejected, by WXDEC_XXX
+	uint64_t newer;			// good records of a version newer than this reader's
+	uint64_t deltas;		// good records that came as delta records
+	uint64_t summaries;		// good summary records
+
+	WxRecordDecoder();
+
+		// Scan the next len bytes of the stream
+	void feed(const uint8_t *data, size_t len, Handler onRecord, void *ctx, SummaryHandler onSummary = NULL);
+		// Decode the COBS bytes of one frame, without its delimiters, into r, or into s if it
+		// is a summary (WXDEC_SUMMARY)
+	int decodeFrame(const uint8_t *cobs, size_t len, WxRecord *r, WxSummary *s);
+		// CRC16-CCITT as the driver computes it
+	static uint16_t crc16(const uint8_t *buf, size_t len, uint16_t crc = 0);
+
+private:
+	// the frame so far, when it started in an earlier chunk
+	uint8_t pending[WXREC_MAX_SIZE + WXREC_MAX_SIZE / 254 + 3];
+	size_t pendingLen;
+	bool pendingLong;		// ...and it is longer than any record
+	WxRecord last[8];		// each station's last record, for its delta records
+	uint8_t keyed;			// bit per station: last holds a record
+	uint8_t seq[8];			// ...and the seq of the delta record it came from, 0 a full record
+
+	int applyDelta(const uint8_t *buf, size_t len, WxRecord *r);
+
+	void frameDone(const uint8_t *cobs, size_t len, Handler onRecord, void *ctx, SummaryHandler onSummary);
+	};
+
+#endif  // WX_RECORD_DECODER_h
@@ -0,0 +1,110 @@
+// Host (Linux) implementation of the Arduino core subset, backed by HostBoard.
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "../HostBoard.h"
+
+HostSerial Serial;
+SPIClass SPI;
+
+uint32_t micros() { return (uint32_t) (board.nowNs / 1000); }
+uint32_t millis() { return (uint32_t) (board.nowNs / 1000000); }
+void delay(uint32_t ms) { board.advance((uint64_t) ms * 1000000); }
+void delayMicroseconds(uint32_t us) { board.advance((uint64_t) us * 1000); }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t val) { board.pinWrite(pin, val ? HIGH : LOW); }
+int digitalRead(uint8_t pin) { return board.pinRead(pin); }
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(), int) { board.attach(interruptNum, userFunc); }
+void detachInterrupt(uint8_t interruptNum) { board.attach(interruptNum, NULL); }
+void noInterrupts() { board.setInterrupts(false); }
+void interrupts() { board.setInterrupts(true); }
+uint32_t __get_PRIMASK() { return board.interruptsEnabled() ? 0 : 1; }
+void __set_PRIMASK(uint32_t primask) { board.setInterrupts(!(primask & 1)); }
+
+uint8_t SPIClass::transfer(uint8_t data) { return board.spiTransfer(data); }
+
+size_t HostSerial::write(uint8_t c) {
+	board.serialWrite(&c, 1);
+	return 1;
+	}
+
+size_t HostSerial::write(const uint8_t *buf, size_t len) {
+	board.serialWrite(buf, len);
+	return len;
+	}
+
+	// the SAMD USB CDC endpoint buffers one 64 byte packet
+int HostSerial::availableForWrite() { return 64; }
+
+size_t HostSerial::print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+size_t HostSerial::print(const char s[]) { return write((const uint8_t *) s, strlen(s)); }
+size_t HostSerial::print(char c) { return write((uint8_t) c); }
+size_t HostSerial::print(unsigned char n, int base) { return print((unsigned long) n, base); }
+size_t HostSerial::print(int n, int base) { return print((long) n, base); }
+size_t HostSerial::print(unsigned int n, int base) { return print((unsigned long) n, base); }
+
+	// 32 bit longs as on the SAMD21, so negative numbers in HEX print as on the board
+size_t HostSerial::print(long n, int base) {
+	int32_t v = (int32_t) n;
+	if (base == 0) return write((uint8_t) v);
+	if (base == 10 && v < 0) {
+		size_t t = print('-');
+		return t + printNumber((uint32_t) -(int64_t) v, 10);
+		}
+	return printNumber((uint32_t) v, base);
+	}
+
+size_t HostSerial::print(unsigned long n, int base) {
+	if (base == 0) return write((uint8_t) n);
+	return printNumber((uint32_t) n, base);
+	}
+
+size_t HostSerial::print(double n, int digits) { return printFloat(n, digits); }
+
+size_t HostSerial::println() { return print("\r\n"); }
+
+size_t HostSerial::printNumber(unsigned long n, uint8_t base) {
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2) base = 10;
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+		} while (n);
+	return print(str);
+	}
+
+	// Same algorithm as the SAMD core's Print::printFloat()
+size_t HostSerial::printFloat(double number, uint8_t digits) {
+	size_t n = 0;
+	if (isnan(number)) return print("nan");
+	if (isinf(number)) return print("inf");
+	if (number > 4294967040.0) return print("ovf");
+	if (number < -4294967040.0) return print("ovf");
+
+	if (number < 0.0) {
+		n += print('-');
+		number = -number;
+		}
+
+	double rounding = 0.5;
+	for (uint8_t i = 0; i < digits; ++i) rounding /= 10.0;
+	number += rounding;
+
+	unsigned long int_part = (unsigned long) number;
+	double remainder = number - (double) int_part;
+	n += print(int_part);
+
+	if (digits > 0) n += print(".");
+	while (digits-- > 0) {
+		remainder *= 10.0;
+		unsigned int toPrint = (unsigned int) remainder;
+		n += print(toPrint);
+		remainder -= toPrint;
+		}
+	return n;
+	}
@@ -0,0 +1,100 @@
+// Host (Linux) stand-in for the subset of the Arduino core used by the DavisRFM69 driver.
+//
+// Together with SPI.h and HostBoard.h this forms the hardware abstraction layer for the
+// host build: time comes from a virtual microsecond clock, pins and interrupts are routed
+// to simulated devices (see RFM69Model.h) and Serial output is counted and optionally echoed.
+// Nothing here is used when building for the Feather M0.
+
+#ifndef HOST_ARDUINO_h
+#define HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x0
+#define OUTPUT 0x1
+
+#define CHANGE  2
+#define FALLING 3
+#define RISING  4
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+inline uint16_t word(uint8_t h, uint8_t l) { return (uint16_t) ((h << 8) | l); }
+
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts();
+void interrupts();
+
+	// CMSIS core intrinsics (PRIMASK is 1 while interrupts are masked)
+uint32_t __get_PRIMASK();
+void __set_PRIMASK(uint32_t primask);
+inline void __disable_irq() { noInterrupts(); }
+inline void __enable_irq() { interrupts(); }
+
+	// Arduino Print semantics (number bases, float rounding, "\r\n" line ends) so that byte
+	// counts and captured text match what the board would send.
+class HostSerial {
+public:
+	void begin(unsigned long) {}
+	operator bool() { return true; }
+
+	size_t write(uint8_t c);
+	size_t write(const uint8_t *buf, size_t len);
+	int availableForWrite();
+	int available() { return 0; }
+	int read() { return -1; }
+	void flush() {}
+
+	size_t print(const __FlashStringHelper *s);
+	size_t print(const char s[]);
+	size_t print(char c);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println();
+	template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+	template <typename T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+
+private:
+	size_t printNumber(unsigned long n, uint8_t base);
+	size_t printFloat(double number, uint8_t digits);
+	};
+
+extern HostSerial Serial;
+
+#endif  // HOST_ARDUINO_h
@@ -0,0 +1,18 @@
+// Host (Linux) stand-in for the Arduino SPI library. Bytes are routed to whichever simulated
+// device currently has its chip select pin driven LOW (see HostBoard.h).
+
+#ifndef HOST_SPI_h
+#define HOST_SPI_h
+
+#include "Arduino.h"
+
+class SPIClass {
+public:
+	void begin() {}
+	void end() {}
+	uint8_t transfer(uint8_t data);
+	};
+
+extern SPIClass SPI;
+
+#endif  // HOST_SPI_h
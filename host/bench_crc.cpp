@@ -0,0 +1,82 @@
+// Checks the table driven CRC16-CCITT routines against the original bitwise loop and times
+// them on the packet check the ISR does (bytes 0..5, then 8..9 on a repeater miss).
+//
+// usage: bench_crc [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "IssSim.h"
+
+typedef uint16_t (*CrcFn)(volatile byte *, byte, uint16_t);
+
+static const struct { const char *name; CrcFn fn; } variants[] = {
+	{ "bitwise", DavisRFM69::crc16_ccitt_bitwise },
+	{ "table16", DavisRFM69::crc16_ccitt_tab16 },
+	{ "table256", DavisRFM69::crc16_ccitt_tab256 },
+	};
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+	}
+
+int main(int argc, char **argv) {
+	uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+	SimRandom rnd(42);
+	int failures = 0;
+
+	// every (initial CRC, byte) pair, then random packet-sized buffers
+	for (uint32_t init = 0; init < 0x10000; init++) {
+		for (uint32_t b = 0; b < 0x100; b++) {
+			byte buf = b;
+			uint16_t ref = DavisRFM69::crc16_ccitt_bitwise(&buf, 1, init);
+			for (size_t v = 1; v < sizeof(variants) / sizeof(variants[0]); v++)
+				if (variants[v].fn(&buf, 1, init) != ref && failures++ < 10)
+					printf("%s mismatch: init %04x byte %02x\n", variants[v].name, init, b);
+			}
+		}
+	for (uint32_t n = 0; n < 1000000; n++) {
+		byte buf[DAVIS_PACKET_LEN];
+		for (byte i = 0; i < DAVIS_PACKET_LEN; i++) buf[i] = rnd.next();
+		byte len = rnd.below(DAVIS_PACKET_LEN + 1);
+		uint16_t init = rnd.next();
+		uint16_t ref = DavisRFM69::crc16_ccitt_bitwise(buf, len, init);
+		for (size_t v = 1; v < sizeof(variants) / sizeof(variants[0]); v++)
+			if (variants[v].fn(buf, len, init) != ref && failures++ < 10)
+				printf("%s mismatch on %u byte buffer\n", variants[v].name, len);
+		}
+	printf("equivalence: %s\n", failures ? "FAILED" : "ok");
+
+	static byte packets[256][DAVIS_PACKET_LEN];
+	for (int p = 0; p < 256; p++)
+		for (byte i = 0; i < DAVIS_PACKET_LEN; i++) packets[p][i] = rnd.next();
+
+	printf("%-10s %12s %14s\n", "variant", "ns/packet", "cycles/packet");
+	for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		volatile uint16_t sink = 0;
+		uint64_t t0 = nowNs(), c0 = cycles();
+		for (uint32_t n = 0; n < iterations; n++) {
+			byte *pkt = packets[n & 255];
+			uint16_t crc = variants[v].fn(pkt, 6, 0);
+			if (crc != word(pkt[6], pkt[7])) crc = variants[v].fn(pkt + 8, 2, crc);
+			sink = sink + crc;
+			}
+		uint64_t t1 = nowNs(), c1 = cycles();
+		printf("%-10s %12.1f %14.1f\n", variants[v].name, (double) (t1 - t0) / iterations,
+			(double) (c1 - c0) / iterations);
+		}
+	return failures ? 1 : 0;
+	}
@@ -0,0 +1,149 @@
+// Checks the integer sensor decoding of DavisRFM69_decode.h against the float expressions
+// decode_packet() had, over every value of the packet bytes they read (2, 3 and 4), and
+// the UV and solar radiation text the sketch prints against Print's of the floats, and
+// times both. The cycles are the host's; the sketch's DECODE_BENCH counts them on the M0.
+//
+// usage: bench_decode [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_decode.h"
+#include "HostBoard.h"
+#include "IssSim.h"
+
+typedef int32_t (*DecodeFn)(const uint8_t *);
+
+	// rate: the float divides by 0 when wxRainRateZero(); UV and solar as WxRecord holds them
+static const struct { const char *name; DecodeFn fixed, ref; bool rate; } readings[] = {
+	{ "windd vp2", [](const uint8_t *p) -> int32_t { return wxWindDir(p, false); },
+		[](const uint8_t *p) -> int32_t { return wxWindDirFloat(p, false); }, false },
+	{ "windd vue", [](const uint8_t *p) -> int32_t { return wxWindDir(p, true); },
+		[](const uint8_t *p) -> int32_t { return wxWindDirFloat(p, true); }, false },
+	{ "uv", [](const uint8_t *p) -> int32_t { return wxUv(p); },
+		[](const uint8_t *p) -> int32_t { return wxFixedFloat(wxUvFloat(p), 100); }, false },
+	{ "solar", [](const uint8_t *p) -> int32_t { return wxRound(wxSolar(p), 3, 1); },
+		[](const uint8_t *p) -> int32_t { return wxFixedFloat(wxSolarFloat(p), 10); }, false },
+	{ "rainrate", [](const uint8_t *p) -> int32_t { return wxRainRate(p); },
+		[](const uint8_t *p) -> int32_t { return wxRainRateFloat(p); }, true },
+	};
+
+#define READINGS	(sizeof(readings) / sizeof(readings[0]))
+
+	// Serial output of print() for every UV and solar raw value, a line each: the "c:"
+	// line's 2 decimals and the debug output's 1
+static char *printed(void (*print)(const uint8_t *, uint8_t)) {
+	char *text;
+	size_t len;
+	board.serialEcho = open_memstream(&text, &len);
+	uint8_t packet[DAVIS_PACKET_LEN] = { 0 };
+	for (uint16_t raw = 0; raw < 0x400; raw++) {
+		packet[3] = raw >> 2;
+		packet[4] = raw << 6;
+		for (uint8_t decimals = 2; decimals > 0; decimals--) print(packet, decimals);
+		Serial.println();
+		}
+	fclose(board.serialEcho);
+	board.serialEcho = NULL;
+	return text;
+	}
+
+static int checkPrinted() {
+	char *want = printed([](const uint8_t *p, uint8_t decimals) {
+		Serial.print(wxUvFloat(p), decimals);
+		Serial.print(',');
+		Serial.print(wxSolarFloat(p), decimals);
+		Serial.print(',');
+		});
+	char *got = printed([](const uint8_t *p, uint8_t decimals) {
+		wxPrintFixed(wxUv(p), 2, decimals);
+		Serial.print(',');
+		wxPrintFixed(wxSolar(p), 3, decimals);
+		Serial.print(',');
+		});
+	uint32_t wrong = 0;
+	char *w = want, *g = got;
+	for (uint16_t raw = 0; *w || *g; raw++) {
+		size_t wl = strcspn(w, "\n"), gl = strcspn(g, "\n");
+		if ((wl != gl || memcmp(w, g, wl)) && wrong++ < 5)
+			printf("printed: raw %u gives %.*s, float %.*s\n", raw, (int) gl, g, (int) wl, w);
+		w += wl + (w[wl] != 0);
+		g += gl + (g[gl] != 0);
+		}
+	printf("%-10s %s\n", "printed", wrong ? "FAILED" : "ok");
+	free(want);
+	free(got);
+	return wrong != 0;
+	}
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+	}
+
+int main(int argc, char **argv) {
+	uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+	SimRandom rnd(25);
+	int failures = 0;
+
+	// every packet[2], [3] and [4]; the rain rate of no rain divided by 0 in float
+	for (size_t r = 0; r < READINGS; r++) {
+		uint32_t wrong = 0, skipped = 0;
+		uint8_t packet[DAVIS_PACKET_LEN] = { 0 };
+		for (uint32_t v = 0; v < 0x1000000; v++) {
+			packet[2] = v >> 16;
+			packet[3] = v >> 8;
+			packet[4] = v;
+			if (readings[r].rate && wxRainRateZero(packet)) {
+				if (readings[r].fixed(packet) != 0 && wrong++ < 5) printf("%s: %02x %02x not 0\n", readings[r].name,
+					packet[3], packet[4]);
+				skipped++;
+				continue;
+				}
+			int32_t want = readings[r].ref(packet), got = readings[r].fixed(packet);
+			if (got != want && wrong++ < 5)
+				printf("%s: %02x %02x %02x gives %d, float %d\n", readings[r].name, packet[2], packet[3], packet[4],
+					got, want);
+			}
+		printf("%-10s %s", readings[r].name, wrong ? "FAILED" : "ok");
+		if (skipped) printf(" (%u inputs without rain, 0 instead of 3600 / 0)", skipped);
+		printf("\n");
+		failures += wrong != 0;
+		}
+	failures += checkPrinted();
+
+	static uint8_t packets[4096][DAVIS_PACKET_LEN];
+	for (int p = 0; p < 4096; p++) {
+		for (byte i = 0; i < DAVIS_PACKET_LEN; i++) packets[p][i] = rnd.next();
+		if (wxRainRateZero(packets[p])) packets[p][3] = 1;		// keep the float rain rate defined
+		}
+
+	printf("%-10s %12s %12s %14s %14s\n", "reading", "float ns", "fixed ns", "float cycles", "fixed cycles");
+	for (size_t r = 0; r < READINGS; r++) {
+		double ns[2], cyc[2];
+		for (int k = 0; k < 2; k++) {
+			DecodeFn fn = k ? readings[r].fixed : readings[r].ref;
+			volatile int32_t sink = 0;
+			uint64_t t0 = nowNs(), c0 = cycles();
+			for (uint32_t n = 0; n < iterations; n++) sink = sink + fn(packets[n & 4095]);
+			uint64_t t1 = nowNs(), c1 = cycles();
+			ns[k] = (double) (t1 - t0) / iterations;
+			cyc[k] = (double) (c1 - c0) / iterations;
+			}
+		printf("%-10s %12.1f %12.1f %14.1f %14.1f\n", readings[r].name, ns[0], ns[1], cyc[0], cyc[1]);
+		}
+	return failures ? 1 : 0;
+	}
@@ -0,0 +1,228 @@
+// Generates a large receiver log, a mix of binary records, "c:" lines, "bme:", "raw:" and
+// "t:" lines, half of them with timestamps, and runs it through WxIngest: checks that
+// every line and record is accounted for and that the column file doesn't depend on how
+// the stream was chunked, then times it, against an fgets/sscanf reader of the same lines.
+//
+// usage: bench_ingest [packets]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_decode.h"
+#include "DavisRFM69_record.h"
+#include "IssSim.h"
+#include "WxIngest.h"
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+struct Log {
+	char *buf;
+	size_t len, cap;
+	IngestStats expect;
+
+	void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+	};
+
+void Log::printf(const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	len += vsnprintf(buf + len, cap - len, fmt, ap);
+	va_end(ap);
+	}
+
+	// the sketch's output for n packets: records, or "c:" lines if csv, with the debug and
+	// sensor lines in between
+static void generate(Log &log, uint32_t n, bool csv, SimRandom &rnd) {
+	memset(&log.expect, 0, sizeof(log.expect));
+	log.len = 0;
+	double t = 1697040000.0;
+	for (uint32_t i = 0; i < n; i++) {
+		t += 2.5 + rnd.below(100) / 1000.0;
+		RadioData rd;
+		memset(&rd, 0, sizeof(rd));
+		for (byte k = 0; k < DAVIS_PACKET_LEN; k++) rd.packet[k] = rnd.next();
+		rd.rssi = 40 + rnd.below(60);
+		rd.channel = rnd.below(51);
+		WxData wx;
+		wx.rain = rnd.below(128);
+		wx.rainrate = rnd.below(3600);
+		wx.rh = rnd.below(1001);
+		wx.solar = rnd.below(8) ? rnd.below(1794853) : -1;
+		wx.temp = (int) rnd.below(1600) - 400;
+		wx.uv = rnd.below(8) ? rnd.below(0x3ff) * 2 : -1;
+		wx.vcap = rnd.below(500);
+		wx.vsolar = rnd.below(500);
+		wx.windd = rnd.below(360);
+		wx.winddraw = rnd.next();
+		wx.windgust = rnd.below(100);
+		wx.windgustd = rnd.below(16);
+		wx.windv = rnd.below(100);
+		uint32_t lost = i / 20;
+		bool stamped = i & 1;
+
+		if (i % 8 == 0) {
+			if (stamped) log.printf("%.3f ", t);
+			log.printf("raw:%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X, station:%u, packets:%u/%u/%.2f, "
+				"channel:%u, rssi:%d, batt:ok, ", rd.packet[0], rd.packet[1], rd.packet[2], rd.packet[3],
+				rd.packet[4], rd.packet[5], rd.packet[6], rd.packet[7], rd.packet[8], rd.packet[9], rd.packet[0] & 7,
+				i + 1, lost, (i + 1) * 100.0 / (i + 1 + lost), rd.channel, -rd.rssi);
+			log.expect.raw++;
+			log.expect.lines++;
+			if (csv) log.printf("\r\n");	// else the record's leading 0 ends it
+			}
+		if (csv) {
+			if (stamped) log.printf("[%.3f] ", t);
+			log.printf("c:%u,%.2f,%d,%s,%u,%u,%u,%.2f,%d,%.2f,%d,%d,%u,%u,%u,%u,%u\r\n", i + 1 + lost,
+				(i + 1) * 100.0 / (i + 1 + lost), -rd.rssi, rd.packet[0] & 0x8 ? "err" : "ok", wx.rain, wx.rainrate,
+				wx.rh, wx.solar < 0 ? -1.0 : wxRound(wx.solar, 3, 2) / 100.0, wx.temp, wx.uv < 0 ? -1.0 : wx.uv / 100.0,
+				wx.vcap, wx.vsolar, wx.windd, wx.winddraw, wx.windgust, wx.windgustd, wx.windv);
+			log.expect.csv++;
+			log.expect.lines++;
+			}
+		else {
+			log.len += wxRecordFrame((uint8_t *) log.buf + log.len, rd, i + 1, lost, wx);
+			log.expect.frames++;
+			}
+		if (i % 16 == 15) {
+			if (stamped) log.printf("%.3f ", t);
+			log.printf("bme:%.2f,%.2f,%.2f\r\n", 15 + rnd.below(1000) / 100.0, 98000 + rnd.below(600000) / 100.0,
+				rnd.below(10000) / 100.0);
+			log.expect.bme++;
+			log.expect.lines++;
+			}
+		if (i % 32 == 7) {
+			log.printf("t:%u 1f 2a 0 7 %u\r\n", i * 2500, rd.channel);
+			log.expect.trace++;
+			log.expect.lines++;
+			}
+		}
+	log.expect.bytes = log.len;
+	}
+
+	// Ingest the log in chunks of up to maxChunk bytes (0: all at once), into out
+static void ingest(const Log &log, FILE *out, size_t maxChunk, SimRandom &rnd, IngestStats *stats) {
+	WxIngest ing(out);
+	for (size_t at = 0; at < log.len; ) {
+		size_t len = maxChunk ? 1 + rnd.below(maxChunk) : log.len;
+		if (len > log.len - at) len = log.len - at;
+		ing.feed((const uint8_t *) log.buf + at, len);
+		at += len;
+		}
+	ing.finish();
+	*stats = ing.stats;
+	}
+
+static bool sameCounts(const IngestStats &a, const IngestStats &b) {
+	return a.bytes == b.bytes && a.lines == b.lines && a.csv == b.csv && a.bme == b.bme && a.raw == b.raw
+		&& a.trace == b.trace && a.frames == b.frames && a.unkeyed == b.unkeyed && a.summaries == b.summaries
+		&& a.other == b.other && a.bad == b.bad;
+	}
+
+static void printCounts(const char *what, const IngestStats &s) {
+	printf("  %-8s lines %llu (c: %llu, bme: %llu, raw: %llu, t: %llu, other %llu, bad %llu), records %llu\n", what,
+		(unsigned long long) s.lines, (unsigned long long) s.csv, (unsigned long long) s.bme,
+		(unsigned long long) s.raw, (unsigned long long) s.trace, (unsigned long long) s.other,
+		(unsigned long long) s.bad, (unsigned long long) s.frames);
+	}
+
+	// the same column file, whole and in small pieces, with every token counted
+static bool check(const Log &log, const char *name, SimRandom &rnd) {
+	char *whole, *pieces;
+	size_t wholeLen, piecesLen;
+	IngestStats s1, s2;
+	FILE *f = open_memstream(&whole, &wholeLen);
+	ingest(log, f, 0, rnd, &s1);
+	fclose(f);
+	f = open_memstream(&pieces, &piecesLen);
+	ingest(log, f, 97, rnd, &s2);
+	fclose(f);
+	bool ok = sameCounts(s1, log.expect) && sameCounts(s2, log.expect) && wholeLen == piecesLen
+		&& !memcmp(whole, pieces, wholeLen);
+	printf("%s: %s, %.1f MB log, %.1f MB column file\n", name, ok ? "ok" : "FAILED", log.len / 1e6, wholeLen / 1e6);
+	if (!ok) {
+		printCounts("expected", log.expect);
+		printCounts("whole", s1);
+		printCounts("pieces", s2);
+		}
+	free(whole);
+	free(pieces);
+	return ok;
+	}
+
+static void report(const char *name, uint64_t ns, uint64_t lines, uint64_t records, size_t bytes) {
+	double secs = ns / 1e9;
+	printf("%-22s %8.1f %12.0f %12.0f %8.1f\n", name, ns / 1e6, (lines + records) / secs, lines / secs,
+		bytes / secs / 1e6);
+	}
+
+	// What a script might do: a line at a time through stdio, sscanf per kind
+static uint64_t naive(const Log &log, uint64_t *parsed) {
+	FILE *f = fmemopen(log.buf, log.len, "r");
+	char line[INGEST_MAX_LINE];
+	uint64_t n = 0;
+	uint64_t t0 = nowNs();
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line;
+		double ts, v[6];
+		unsigned u[12];
+		char batt[4];
+		int len;
+		if (sscanf(p, "[%lf] %n", &ts, &len) == 1 || sscanf(p, "%lf %n", &ts, &len) == 1) p += len;
+		if (sscanf(p, "c:%u,%lf,%lf,%3[a-z],%u,%u,%u,%lf,%lf,%lf,%u,%u,%u,%u,%u,%u,%u", &u[0], &v[0], &v[1], batt,
+			&u[1], &u[2], &u[3], &v[2], &v[3], &v[4], &u[4], &u[5], &u[6], &u[7], &u[8], &u[9], &u[10]) == 17) n++;
+		else if (sscanf(p, "bme:%lf,%lf,%lf", &v[0], &v[1], &v[2]) == 3) n++;
+		}
+	uint64_t ns = nowNs() - t0;
+	fclose(f);
+	*parsed = n;
+	return ns;
+	}
+
+int main(int argc, char **argv) {
+	uint32_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	SimRandom rnd(7);
+	int failures = 0;
+
+	Log text = { NULL, 0, (size_t) n * 400 };
+	Log mixed = { NULL, 0, (size_t) n * 300 };
+	text.buf = (char *) malloc(text.cap);
+	mixed.buf = (char *) malloc(mixed.cap);
+	generate(text, n, true, rnd);
+	generate(mixed, n, false, rnd);
+	failures += !check(text, "csv log", rnd);
+	failures += !check(mixed, "binary log", rnd);
+
+	FILE *null = fopen("/dev/null", "wb");
+	static char outBuf[1 << 20];
+	setvbuf(null, outBuf, _IOFBF, sizeof(outBuf));
+	printf("%-22s %8s %12s %12s %8s\n", "", "ms", "rows/s", "lines/s", "MB/s");
+	IngestStats s;
+	uint64_t t0 = nowNs();
+	ingest(text, null, 0, rnd, &s);
+	report("WxIngest, csv log", nowNs() - t0, s.lines, s.frames, text.len);
+	t0 = nowNs();
+	ingest(text, null, 1 << 16, rnd, &s);
+	report("  in 64k reads", nowNs() - t0, s.lines, s.frames, text.len);
+	t0 = nowNs();
+	ingest(mixed, null, 0, rnd, &s);
+	report("WxIngest, binary log", nowNs() - t0, s.lines, s.frames, mixed.len);
+	uint64_t parsed;
+	uint64_t ns = naive(text, &parsed);
+	report("fgets/sscanf, csv log", ns, text.expect.lines, 0, text.len);
+	if (parsed != text.expect.csv + text.expect.bme) {
+		printf("fgets/sscanf parsed %llu of %llu lines\n", (unsigned long long) parsed,
+			(unsigned long long) (text.expect.csv + text.expect.bme));
+		failures++;
+		}
+	fclose(null);
+	return failures ? 1 : 0;
+	}
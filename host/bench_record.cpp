@@ -0,0 +1,319 @@
+// Checks the binary weather record (DavisRFM69_record.h) round trip through
+// WxRecordDecoder, and compares it with the "c:" CSV line it replaces: bytes on the wire,
+// time to produce one and time to parse one. Then the same for delta records, over
+// readings that change as a station's do.
+//
+// usage: bench_record [records]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_decode.h"
+#include "DavisRFM69_record.h"
+#include "IssSim.h"
+#include "WxRecordDecoder.h"
+
+struct Sample {
+	RadioData rd;
+	uint32_t packets, lost;
+	WxData wx;
+	};
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+static void randomSample(SimRandom &rnd, uint32_t n, Sample &s) {
+	memset(&s.rd, 0, sizeof(s.rd));
+	for (byte i = 0; i < DAVIS_PACKET_LEN; i++) s.rd.packet[i] = rnd.next();
+	s.rd.rssi = 40 + rnd.below(60);
+	s.packets = n;
+	s.lost = rnd.below(n / 10 + 1);
+	s.wx = WxData();
+	s.wx.rain = rnd.below(128);
+	s.wx.rainrate = rnd.below(3600);
+	s.wx.rh = rnd.below(1001);
+	s.wx.soilleaf = -1;
+	s.wx.solar = rnd.below(8) ? rnd.below(1794853) : -1;
+	s.wx.temp = (int) rnd.below(1600) - 400;
+	s.wx.uv = rnd.below(8) ? rnd.below(0x3ff) * 2 : -1;
+	s.wx.vcap = rnd.below(500);
+	s.wx.vsolar = rnd.below(500);
+	s.wx.windd = rnd.below(360);
+	s.wx.winddraw = rnd.next();
+	s.wx.windgust = rnd.below(100);
+	s.wx.windgustd = rnd.below(16);
+	s.wx.windv = rnd.below(100);
+	}
+
+	// Station id's next packet after prev: wind moves a little, and the reading of the
+	// packet's type
+static void stationSample(SimRandom &rnd, uint32_t n, const Sample &prev, byte id, byte seq, Sample &s) {
+	static const byte types[] = { VP2P_TEMP, VP2P_HUMIDITY, VP2P_UV, VP2P_SOLAR, VP2P_RAIN, VP2P_WINDGUST, VP2P_RAINSECS };
+	s = prev;
+	byte type = types[seq % sizeof(types)];
+	s.rd.packet[0] = type << 4 | id;
+	s.rd.rssi = 60 + rnd.below(5);
+	s.packets = n;
+	s.lost = prev.lost + (rnd.below(50) == 0);
+	int windv = s.wx.windv + (int) rnd.below(3) - 1;
+	s.wx.windv = windv < 0 ? 0 : windv;
+	if (rnd.below(2)) {
+		s.wx.winddraw += rnd.below(5) - 2;
+		s.wx.windd = s.wx.winddraw * 360 / 256;
+		}
+	switch (type) {
+		case VP2P_TEMP: s.wx.temp += (int) rnd.below(3) - 1; break;
+		case VP2P_HUMIDITY: s.wx.rh += rnd.below(4) == 0; break;
+		case VP2P_UV: s.wx.uv = rnd.below(4) * 2; break;
+		case VP2P_SOLAR: s.wx.solar = rnd.below(10) * 1757; break;
+		case VP2P_RAIN: s.wx.rain += rnd.below(20) == 0; break;
+		case VP2P_WINDGUST: s.wx.windgust = s.wx.windv + rnd.below(4); break;
+		}
+	}
+
+	// what the sketch's "c:" line holds, as Print formats it
+static int csvLine(char *buf, size_t size, const Sample &s) {
+	return snprintf(buf, size, "c:%u,%.2f,%u,%s,%u,%u,%u,%.2f,%d,%.2f,%d,%d,%u,%u,%u,%u,%u\r\n",
+		s.packets + s.lost, s.packets * 100.0 / (s.packets + s.lost), s.rd.rssi, s.rd.packet[0] & 0x8 ? "err" : "ok",
+		s.wx.rain, s.wx.rainrate, s.wx.rh, s.wx.solar < 0 ? -1.0 : wxRound(s.wx.solar, 3, 2) / 100.0, s.wx.temp,
+		s.wx.uv < 0 ? -1.0 : s.wx.uv / 100.0, s.wx.vcap, s.wx.vsolar, s.wx.windd, s.wx.winddraw, s.wx.windgust,
+		s.wx.windgustd, s.wx.windv);
+	}
+
+	// parse a "c:" line back into its 17 fields
+static int csvParse(const char *p, const char *end, double *f) {
+	int n = 0;
+	p += 2;
+	while (p < end && n < 17) {
+		char *q;
+		if (*p == 'o' || *p == 'e') {
+			f[n++] = *p == 'e';
+			while (p < end && *p != ',' && *p != '\r') p++;
+			}
+		else {
+			f[n++] = strtod(p, &q);
+			p = q;
+			}
+		if (p < end && *p == ',') p++;
+		else break;
+		}
+	return n;
+	}
+
+static bool matches(const WxRecord &r, const Sample &s) {
+	return r.version == WXREC_VERSION && r.station == (s.rd.packet[0] & 7) && r.type == s.rd.packet[0] >> 4
+		&& r.flags == (s.rd.packet[0] & 8 ? WXREC_BATT_LOW : 0) && r.rssi == s.rd.rssi
+		&& r.packets == s.packets && r.lostPackets == s.lost && r.rain == s.wx.rain
+		&& r.rainrate == s.wx.rainrate && r.rh == s.wx.rh && r.soilleaf == s.wx.soilleaf
+		&& r.solar == wxRound(s.wx.solar, 3, 1) && r.temp == s.wx.temp && r.uv == s.wx.uv
+		&& r.vcap == s.wx.vcap && r.vsolar == s.wx.vsolar && r.windd == s.wx.windd
+		&& r.winddraw == s.wx.winddraw && r.windgust == s.wx.windgust && r.windgustd == s.wx.windgustd
+		&& r.windv == s.wx.windv;
+	}
+
+struct Check {
+	const Sample *samples;
+	uint32_t next;			// index of the sample the next record should be
+	uint32_t wrong;
+	const bool *corrupted;	// records expected to be rejected
+	};
+
+static void checkRecord(const WxRecord &r, void *ctx) {
+	Check &c = *(Check *) ctx;
+	if (c.corrupted) while (c.corrupted[c.next]) c.next++;
+	if (!matches(r, c.samples[c.next]) && c.wrong++ < 10) printf("record %u decoded wrong\n", c.next);
+	c.next++;
+	}
+
+	// a record from a stream with frames left out: whichever sample it is, it must be right
+static void checkByPackets(const WxRecord &r, void *ctx) {
+	Check &c = *(Check *) ctx;
+	if ((r.packets == 0 || !matches(r, c.samples[r.packets - 1])) && c.wrong++ < 10)
+		printf("record of packet %u decoded wrong\n", r.packets);
+	c.next++;
+	}
+
+static void countRecord(const WxRecord &r, void *ctx) { *(uint32_t *) ctx += r.windv; }
+
+int main(int argc, char **argv) {
+	uint32_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+	SimRandom rnd(42);
+	int failures = 0;
+
+	Sample *samples = new Sample[n];
+	for (uint32_t i = 0; i < n; i++) randomSample(rnd, i + 1, samples[i]);
+
+	// the serial stream: a record per packet, a bme: line now and then
+	static const char bme[] = "bme:21.50,101325.00,45.20\r\n";
+	size_t binCap = (size_t) n * (WXREC_FRAME_MAX + sizeof(bme));
+	uint8_t *bin = new uint8_t[binCap];
+	size_t *frameAt = new size_t[n];
+	size_t binLen = 0;
+	uint64_t t0 = nowNs();
+	for (uint32_t i = 0; i < n; i++) {
+		frameAt[i] = binLen;
+		binLen += wxRecordFrame(bin + binLen, samples[i].rd, samples[i].packets, samples[i].lost, samples[i].wx);
+		if (i % 16 == 15) {
+			memcpy(bin + binLen, bme, sizeof(bme) - 1);
+			binLen += sizeof(bme) - 1;
+			}
+		}
+	uint64_t binEncodeNs = nowNs() - t0;
+
+	size_t csvCap = (size_t) n * 160;
+	char *csv = new char[csvCap];
+	size_t csvLen = 0;
+	t0 = nowNs();
+	for (uint32_t i = 0; i < n; i++) {
+		csvLen += csvLine(csv + csvLen, csvCap - csvLen, samples[i]);
+		if (i % 16 == 15) {
+			memcpy(csv + csvLen, bme, sizeof(bme) - 1);
+			csvLen += sizeof(bme) - 1;
+			}
+		}
+	uint64_t csvEncodeNs = nowNs() - t0;
+
+	// every record back, fed in one piece and in random pieces
+	for (int pass = 0; pass < 2; pass++) {
+		WxRecordDecoder dec;
+		Check c = { samples, 0, 0, NULL };
+		for (size_t at = 0; at < binLen; ) {
+			size_t len = pass == 0 ? binLen : 1 + rnd.below(64);
+			if (len > binLen - at) len = binLen - at;
+			dec.feed(bin + at, len, checkRecord, &c);
+			at += len;
+			}
+		if (c.next != n || c.wrong || dec.records != n) {
+			printf("round trip (%s): %u of %u records, %u wrong\n", pass ? "pieces" : "whole", c.next, n, c.wrong);
+			failures++;
+			}
+		}
+
+	// damage one byte in some frames: those, and only those, are rejected
+	uint8_t *damaged = new uint8_t[binLen];
+	memcpy(damaged, bin, binLen);
+	bool *corrupted = new bool[n + 1]();
+	uint32_t nCorrupted = 0;
+	for (uint32_t i = 0; i < n; i += 1 + rnd.below(20)) {
+		size_t len = (i + 1 < n ? frameAt[i + 1] : binLen) - frameAt[i];
+		size_t at = frameAt[i] + 1 + rnd.below(WXREC_V1_SIZE + 3);	// inside the delimiters
+		if (at >= frameAt[i] + len - 1) continue;
+		damaged[at] ^= 1 + rnd.below(255);
+		corrupted[i] = true;
+		nCorrupted++;
+		}
+	{
+		WxRecordDecoder dec;
+		Check c = { samples, 0, 0, corrupted };
+		dec.feed(damaged, binLen, checkRecord, &c);
+		if (dec.records != n - nCorrupted || c.wrong) {
+			printf("damaged frames: %llu of %u good records, %u wrong\n", (unsigned long long) dec.records,
+				n - nCorrupted, c.wrong);
+			failures++;
+			}
+		}
+	printf("round trip: %s (%u records, %u damaged)\n", failures ? "FAILED" : "ok", n, nCorrupted);
+
+	// parse cost, the whole stream at once as an ingestion host reads a log
+	uint32_t sink = 0;
+	WxRecordDecoder dec;
+	t0 = nowNs();
+	dec.feed(bin, binLen, countRecord, &sink);
+	uint64_t binParseNs = nowNs() - t0;
+
+	t0 = nowNs();
+	uint32_t lines = 0;
+	for (const char *p = csv, *end = csv + csvLen; p < end; ) {
+		const char *eol = (const char *) memchr(p, '\n', end - p);
+		if (eol == NULL) eol = end;
+		if (p[0] == 'c' && p[1] == ':') {
+			double f[17];
+			if (csvParse(p, eol, f) == 17) {
+				sink += (uint32_t) f[16];
+				lines++;
+				}
+			}
+		p = eol + 1;
+		}
+	uint64_t csvParseNs = nowNs() - t0;
+	if (lines != n) {
+		printf("csv: parsed %u of %u lines\n", lines, n);
+		failures++;
+		}
+
+	// delta records of two stations, through the encoder and back, whole and in pieces
+	Sample *stream = new Sample[n];
+	Sample prev[2];
+	for (byte k = 0; k < 2; k++) {
+		randomSample(rnd, 1, prev[k]);
+		prev[k].wx.uv = prev[k].wx.solar = 0;
+		}
+	for (uint32_t i = 0; i < n; i++) {
+		byte k = i & 1;
+		stationSample(rnd, i + 1, prev[k], k * 2, i / 2, stream[i]);
+		prev[k] = stream[i];
+		}
+	uint8_t *delta = new uint8_t[(size_t) n * WXREC_FRAME_MAX];
+	size_t deltaLen = 0;
+	WxRecordEncoder enc;
+	t0 = nowNs();
+	for (uint32_t i = 0; i < n; i++) {
+		frameAt[i] = deltaLen;
+		deltaLen += enc.frame(delta + deltaLen, stream[i].rd, stream[i].packets, stream[i].lost, stream[i].wx);
+		}
+	uint64_t deltaEncodeNs = nowNs() - t0;
+	uint64_t deltas = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		WxRecordDecoder dec;
+		Check c = { stream, 0, 0, NULL };
+		for (size_t at = 0; at < deltaLen; ) {
+			size_t len = pass == 0 ? deltaLen : 1 + rnd.below(64);
+			if (len > deltaLen - at) len = deltaLen - at;
+			dec.feed(delta + at, len, checkRecord, &c);
+			at += len;
+			}
+		if (c.next != n || c.wrong || dec.records != n) {
+			printf("delta round trip (%s): %u of %u records, %u wrong\n", pass ? "pieces" : "whole", c.next, n, c.wrong);
+			failures++;
+			}
+		deltas = dec.deltas;
+		}
+	// ...and with frames lost: the decoder must notice, and hand out nothing stale until
+	// the station's next full record
+	WxRecordDecoder lossy;
+	Check c = { stream, 0, 0, NULL };
+	uint32_t lost = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		size_t end = i + 1 < n ? frameAt[i + 1] : deltaLen;
+		if (rnd.below(100) == 0) lost++;
+		else lossy.feed(delta + frameAt[i], end - frameAt[i], checkByPackets, &c);
+		}
+	if (c.wrong || lossy.errors[WXDEC_NOKEY] == 0 || c.next + lost + lossy.errors[WXDEC_NOKEY] != n) {
+		printf("delta with lost frames: %u records, %u wrong, %llu waiting for a full record, %u lost\n", c.next,
+			c.wrong, (unsigned long long) lossy.errors[WXDEC_NOKEY], lost);
+		failures++;
+		}
+	printf("delta round trip: %s (%u station records, %llu as deltas; with %u lost, %llu dropped until a full record)\n",
+		failures ? "FAILED" : "ok", n, (unsigned long long) deltas, lost, (unsigned long long) lossy.errors[WXDEC_NOKEY]);
+	WxRecordDecoder deltaDec;
+	t0 = nowNs();
+	deltaDec.feed(delta, deltaLen, countRecord, &sink);
+	uint64_t deltaParseNs = nowNs() - t0;
+
+	printf("%-8s %12s %14s %14s\n", "format", "bytes/pkt", "ns/pkt encode", "ns/pkt parse");
+	printf("%-8s %12.1f %14.1f %14.1f\n", "csv", (double) (csvLen - (n / 16) * (sizeof(bme) - 1)) / n,
+		(double) csvEncodeNs / n, (double) csvParseNs / n);
+	printf("%-8s %12.1f %14.1f %14.1f\n", "binary", (double) (binLen - (n / 16) * (sizeof(bme) - 1)) / n,
+		(double) binEncodeNs / n, (double) binParseNs / n);
+	printf("%-8s %12.1f %14.1f %14.1f\n", "delta", (double) deltaLen / n, (double) deltaEncodeNs / n,
+		(double) deltaParseNs / n);
+	printf("(checksum %u)\n", sink);
+	return failures ? 1 : 0;
+	}
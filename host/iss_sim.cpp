@@ -0,0 +1,412 @@
+// Multi-station reception-rate benchmark for DavisRFM69, run in virtual time.
+//
+// Synthetic ISS transmitters (IssSim) drive the RFM69 model while the driver is polled
+// the way FeatherM0_Davis_ISS_rx.ino polls it, including the Serial output it produces per
+// packet. Reports packets received vs. transmitted per station, and how long the driver
+// took to synchronize with a station, from a cold start and after losing one.
+//
+// usage: iss_sim [options]
+//   --days D             simulated time (default 1)
+//   --band us|au|eu|nz   frequency band (default us)
+//   --station ID[:PPM[:LOSS%[:RSSI[:JITTER_US[:PRIORITY[:OFFSET_HZ]]]]]]
+//                        add a transmitter (default: 0 and 2, as in the sketch); PRIORITY
+//                        is the driver's Station.priority for COLLIDE_PRIORITY, OFFSET_HZ
+//                        its carrier offset
+//   --chan-spread HZ     every station's carrier is off by up to +-HZ more on each channel
+//   --bw narrow|wide     receiver bandwidth, setBandwidth() (default wide, as in the sketch)
+//   --loop-us N          time between calls to radio.loop() (default 1000)
+//   --serial-ns N        time Serial blocks per byte (default 10000)
+//   --seed N             random seed (default 1)
+//   --outage S:EVERY     no packet gets through for S seconds at the start of every
+//                        EVERY seconds, for long runs of misses
+//   --restart S          initialize the driver again every S seconds, for more cold starts
+//   --idle               skip loop() calls for radio.idleTime(), waking on interrupts,
+//                        as a sketch sleeping between calls would
+//   --dual same|split    a second RFM69, with DavisRFM69Diversity in that mode
+//   --delta              delta records (WxRecordEncoder, the sketch's DELTA_OUTPUT)
+//   --batch N:S          summaries every N packets or S seconds (WxBatcher, BATCH_OUTPUT)
+//   -v                   echo the sketch's Serial output
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include "DavisRFM69.h"
+#include "DavisRFM69_batch.h"
+#include "DavisRFM69_decode.h"
+#include "DavisRFM69_diversity.h"
+#include "DavisRFM69_record.h"
+#include "DavisRFM69_weather.h"
+#include "HostBoard.h"
+#include "RFM69Model.h"
+#include "IssSim.h"
+
+static DavisRFM69 radio(SPI_CS, RF69_IRQ_PIN, RF69_IRQ_NUM);
+static DavisRFM69 radio2(SPI_CS_2, RF69_IRQ_PIN_2, RF69_IRQ_NUM_2);
+static DavisRFM69Diversity<DavisRFM69> *dual;	// --dual: both radios, through this
+static Station stations[ISS_SIM_MAX_STATIONS];
+
+#define SYNC_SAMPLES 4096
+
+	// times to synchronize with a station, in seconds
+struct SyncTimes {
+	uint32_t n;
+	double s[SYNC_SAMPLES];
+	};
+
+static SyncTimes coldSync, lostSync;
+
+static void addSyncTime(SyncTimes &t, double secs) {
+	if (t.n < SYNC_SAMPLES) t.s[t.n++] = secs;
+	}
+
+static int cmpDouble(const void *a, const void *b) {
+	double d = *(const double *) a - *(const double *) b;
+	return d < 0 ? -1 : d > 0;
+	}
+
+static void printSyncTimes(const char *name, SyncTimes &t) {
+	if (t.n == 0) return;
+	qsort(t.s, t.n, sizeof(t.s[0]), cmpDouble);
+	double sum = 0;
+	for (uint32_t i = 0; i < t.n; i++) sum += t.s[i];
+	printf("%-12s %6u %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, t.n, t.s[0], sum / t.n, t.s[t.n / 2],
+		t.s[t.n * 9 / 10], t.s[t.n - 1]);
+	}
+
+static WxStations weather;
+static WxRecordEncoder records;
+static bool deltaOutput;
+static uint64_t recordBytes;		// Serial output of emitPacket()'s records
+static WxBatcher *batch;			// --batch
+static uint32_t batchFirstMs;		// millis() of the first packet waiting in the batch
+static uint64_t batchSumMs;			// ...the sum of all of theirs
+static double latencySum;			// seconds from the packets' reception to their summaries
+static uint32_t latencyMaxMs, latencyPackets;
+
+	// The readings of a packet into its station's WxData, the main ones as decode_packet()
+	// decodes them
+static void decodeWx(const byte *packet, WxData &wx) {
+	wx.windv = packet[1] >= 7 ? packet[1] + 1 : packet[1];
+	wx.winddraw = packet[2];
+	wx.windd = wxWindDir(packet, false);
+	uint16_t v = word(packet[3], packet[4]);
+	switch (packet[0] >> 4) {
+		case VP2P_UV: wx.uv = wxUv(packet); break;
+		case VP2P_SOLAR: wx.solar = wxSolar(packet); break;
+		case VP2P_RAIN: wx.rain = packet[3]; break;
+		case VP2P_TEMP: wx.temp = (int16_t) v / 16; break;
+		case VP2P_HUMIDITY: wx.rh = (packet[4] >> 4) << 8 | packet[3]; break;
+		case VP2P_WINDGUST: wx.windgust = packet[3] >= 7 ? packet[3] + 1 : packet[3]; break;
+		case VUEP_VCAP: wx.vcap = packet[3] << 2 | (packet[4] & 0xc0) >> 6; break;
+		case VUEP_VSOLAR: wx.vsolar = packet[3] << 2 | (packet[4] & 0xc0) >> 6; break;
+		}
+	}
+
+	// what decode_packet() puts on the wire for one packet
+static void emitPacket(const RadioData *rd) {
+#ifdef DAVISRFM69_DEBUG
+	Serial.print(F("raw:"));
+	for (byte i = 0; i < DAVIS_PACKET_LEN; i++) {
+		if (!(rd->packet[i] & 0xf0)) Serial.print('0');
+		Serial.print(rd->packet[i], HEX);
+		if (i < DAVIS_PACKET_LEN - 1) Serial.print('-');
+		}
+	Serial.print(F(", station:"));
+	Serial.print(rd->packet[0] & 7);
+	Serial.print(F(", channel:"));
+	Serial.print(rd->channel);
+	Serial.print(F(", rssi:"));
+	Serial.print(-rd->rssi);
+	Serial.print(F(", delta:"));
+	Serial.print(rd->delta);
+	Serial.println();
+#endif
+	byte id = rd->packet[0] & 7;
+	decodeWx(rd->packet, weather.update(id));
+	weather.done(id);
+	if (batch) {
+		uint32_t now = millis();
+		if (batch->pending == 0) batchFirstMs = now;
+		batchSumMs += now;
+		batch->add(*rd, weather[id], now);
+		return;
+		}
+	byte frame[WXREC_FRAME_MAX];
+	size_t len = deltaOutput ? records.frame(frame, *rd, radio.packets, radio.lostPackets, weather[id])
+		: wxRecordFrame(frame, *rd, radio.packets, radio.lostPackets, weather[id]);
+	Serial.write(frame, len);
+	recordBytes += len;
+	}
+
+	// the sketch's loop() sending a batch of summaries once it is due
+static void flushBatch() {
+	uint32_t now = millis();
+	if (!batch->due(now)) return;
+	uint16_t n = batch->pending;
+	latencySum += ((double) n * now - batchSumMs) / 1000;
+	if (now - batchFirstMs > latencyMaxMs) latencyMaxMs = now - batchFirstMs;
+	latencyPackets += n;
+	batchSumMs = 0;
+	byte frame[WXREC_SUMMARY_FRAME_MAX];
+	while (size_t len = batch->nextFrame(frame, radio.packets, radio.lostPackets, now)) {
+		Serial.write(frame, len);
+		recordBytes += len;
+		}
+	}
+
+static void printDriver(const char *name, DavisRFM69 &r, RFM69Model &m) {
+	printf("%s: packets %u, lost %u, crc errors %u, dropped isr %u / queue %u, fifo overruns %u\n", name,
+		(unsigned) r.packets, (unsigned) r.lostPackets, (unsigned) r.crcErrors,
+		(unsigned) r.rawDropped(), (unsigned) r.packetFifo.dropped, m.overruns);
+	}
+
+static bool parseBand(const char *s, uint8_t *band) {
+	static const char *names[] = { "us", "au", "eu", "nz" };
+	for (uint8_t i = 0; i < 4; i++)
+		if (!strcmp(s, names[i])) { *band = i; return true; }
+	return false;
+	}
+
+static void usage() {
+	fprintf(stderr, "usage: iss_sim [--days D] [--band us|au|eu|nz] [--station ID[:PPM[:LOSS%%[:RSSI[:JITTER_US[:PRIORITY[:OFFSET_HZ]]]]]]]...\n"
+		"               [--chan-spread HZ] [--bw narrow|wide] [--loop-us N] [--serial-ns N] [--seed N] [--outage S:EVERY] [--restart S] [--idle]\n"
+		"               [--dual same|split] [--delta] [--batch N:S] [-v]\n");
+	exit(2);
+	}
+
+int main(int argc, char **argv) {
+	double days = 1;
+	uint8_t band = FREQ_BAND_US;
+	uint32_t loopNs = 1000000;
+	uint64_t seed = 1;
+	bool idle = false;
+	double outageS = 0, outageEveryS = 0, restartS = 0;
+	int chanSpreadHz = 0;
+	uint8_t bw = RF69_DAVIS_BW_WIDE;
+	int dualMode = -1;
+	IssConfig cfgs[ISS_SIM_MAX_STATIONS];
+	uint8_t priority[ISS_SIM_MAX_STATIONS] = { 0 };
+	uint8_t n = 0;
+
+	board.serialByteNs = 10000;
+	for (int a = 1; a < argc; a++) {
+		const char *arg = argv[a];
+		const char *val = a + 1 < argc ? argv[a + 1] : NULL;
+		if (!strcmp(arg, "-v")) board.serialEcho = stdout;
+		else if (!strcmp(arg, "--idle")) idle = true;
+		else if (!strcmp(arg, "--delta")) deltaOutput = true;
+		else if (!val) usage();
+		else if (!strcmp(arg, "--days")) { days = atof(val); a++; }
+		else if (!strcmp(arg, "--band")) { if (!parseBand(val, &band)) usage(); a++; }
+		else if (!strcmp(arg, "--loop-us")) { loopNs = atoi(val) * 1000; a++; }
+		else if (!strcmp(arg, "--serial-ns")) { board.serialByteNs = atoi(val); a++; }
+		else if (!strcmp(arg, "--seed")) { seed = strtoull(val, NULL, 0); a++; }
+		else if (!strcmp(arg, "--outage")) {
+			const char *p = strchr(val, ':');
+			if (!p) usage();
+			outageS = atof(val);
+			outageEveryS = atof(p + 1);
+			a++;
+			}
+		else if (!strcmp(arg, "--restart")) { restartS = atof(val); a++; }
+		else if (!strcmp(arg, "--batch")) {
+			const char *p = strchr(val, ':');
+			batch = new WxBatcher(atoi(val), p ? (uint32_t) (atof(p + 1) * 1000) : WXBATCH_MS);
+			a++;
+			}
+		else if (!strcmp(arg, "--chan-spread")) { chanSpreadHz = atoi(val); a++; }
+		else if (!strcmp(arg, "--dual")) {
+			if (!strcmp(val, "same")) dualMode = DIVERSITY_SAME;
+			else if (!strcmp(val, "split")) dualMode = DIVERSITY_SPLIT;
+			else usage();
+			a++;
+			}
+		else if (!strcmp(arg, "--bw")) {
+			if (!strcmp(val, "narrow")) bw = RF69_DAVIS_BW_NARROW;
+			else if (!strcmp(val, "wide")) bw = RF69_DAVIS_BW_WIDE;
+			else usage();
+			a++;
+			}
+		else if (!strcmp(arg, "--station") && n < ISS_SIM_MAX_STATIONS) {
+			IssConfig c = { 0, 0, 0, -70, 5, ISS_TYPE == STYPE_VUE, 0, 0 };
+			c.id = atoi(val) & 7;
+			const char *p = strchr(val, ':');
+			if (p) { c.driftPpm = atof(++p); p = strchr(p, ':'); }
+			if (p) { c.lossPct = atof(++p); p = strchr(p, ':'); }
+			if (p) { c.rssiDbm = atoi(++p); p = strchr(p, ':'); }
+			if (p) { c.txJitterUs = atoi(++p); p = strchr(p, ':'); }
+			if (p) { priority[n] = atoi(++p); p = strchr(p, ':'); }
+			if (p) { c.freqOffsetHz = atoi(++p); }
+			cfgs[n++] = c;
+			a++;
+			}
+		else usage();
+		}
+	if (n == 0) {
+		cfgs[n++] = (IssConfig) { 0, 12, 2, -75, 5, ISS_TYPE == STYPE_VUE, 0, 0 };
+		cfgs[n++] = (IssConfig) { 2, -8, 2, -85, 5, ISS_TYPE == STYPE_VUE, 0, 0 };
+		}
+
+	RFM69Model model(SPI_CS, RF69_IRQ_NUM);
+	RFM69Model model2(SPI_CS_2, RF69_IRQ_NUM_2);
+	IssSim sim(model, band, seed);
+	if (dualMode >= 0) {
+		sim.addReceiver(model2);
+		dual = new DavisRFM69Diversity<DavisRFM69>(radio, radio2, dualMode);
+		}
+	sim.outageNs = (uint64_t) (outageS * 1e9);
+	sim.outageEveryNs = (uint64_t) (outageEveryS * 1e9);
+	sim.chanSpreadHz = chanSpreadHz;
+	for (uint8_t i = 0; i < n; i++) {
+		sim.addStation(cfgs[i]);
+		stations[i] = (Station) { .id = cfgs[i].id, .type = ISS_TYPE, .active = true, .priority = priority[i] };
+		}
+	if (dual) {
+		dual->setStations(stations, n);
+		dual->initialize(band);
+		dual->setBandwidth(bw);
+		}
+	else {
+		radio.setStations(stations, n);
+		radio.initialize(band);
+		radio.setBandwidth(bw);
+		}
+	DavisRFM69::PacketQueue &packetFifo = dual ? dual->packetFifo : radio.packetFifo;
+
+	const uint64_t dayNs = 86400ULL * 1000000000ULL;
+	const uint64_t endNs = (uint64_t) (days * dayNs);
+	uint64_t nextReport = dayNs;
+	clock_t wall = clock();
+
+	uint64_t nextLoop = 0, loops = 0, irqSeen = 0;
+	const uint64_t restartNs = (uint64_t) (restartS * 1e9);
+	uint64_t nextRestart = restartNs ? restartNs : UINT64_MAX;
+	// since when each station hasn't been synchronized, and whether that is from a cold start
+	uint64_t unsyncedAt[ISS_SIM_MAX_STATIONS] = { 0 };
+	bool unsynced[ISS_SIM_MAX_STATIONS], cold[ISS_SIM_MAX_STATIONS];
+	for (uint8_t i = 0; i < n; i++) unsynced[i] = cold[i] = true;
+	while (board.nowNs < endNs) {
+		if (board.nowNs >= nextLoop || (idle && board.irqCount != irqSeen)) {
+			// one pass of the sketch's loop()
+			RadioData *rd = packetFifo.peek();
+			if (rd != NULL) {
+				sim.countReceived(rd->packet);
+				emitPacket(rd);
+				packetFifo.pop();
+				}
+			if (batch) flushBatch();
+			if (board.nowNs >= nextRestart) {
+				if (dual) {
+					dual->initialize(band);
+					dual->setBandwidth(bw);
+					}
+				else {
+					radio.initialize(band);
+					radio.setBandwidth(bw);
+					}
+				for (uint8_t i = 0; i < n; i++) {
+					unsynced[i] = cold[i] = true;
+					unsyncedAt[i] = board.nowNs;
+					}
+				nextRestart += restartNs;
+				}
+			if (dual) dual->loop();
+			else radio.loop();
+			loops++;
+			for (uint8_t i = 0; i < n; i++) {
+				bool synced = dual ? dual->synced(i) : radio.stations[i].interval != 0;
+				if (synced && unsynced[i]) {
+					addSyncTime(cold[i] ? coldSync : lostSync, (board.nowNs - unsyncedAt[i]) / 1e9);
+					unsynced[i] = false;
+					}
+				else if (!synced && !unsynced[i]) {
+					unsynced[i] = true;
+					cold[i] = false;
+					unsyncedAt[i] = board.nowNs;
+					}
+				}
+			nextLoop = board.nowNs + loopNs;
+			if (idle) {
+				uint64_t sleepNs = (uint64_t) (dual ? dual->idleTime() : radio.idleTime()) * 1000;
+				if (sleepNs > loopNs) nextLoop = board.nowNs + sleepNs;
+				irqSeen = board.irqCount;
+				}
+			}
+
+		// on to whatever happens next: the next loop() call, the end of a packet on the
+		// air or a peripheral interrupt
+		uint64_t next = nextLoop;
+		if (sim.nextEventNs() < next) next = sim.nextEventNs();
+		if (board.nextTimerNs() < next) next = board.nextTimerNs();
+		board.advanceTo(next);
+		sim.run();
+
+		if (board.nowNs >= nextReport) {
+			printf("day %3u:", (unsigned) (nextReport / dayNs));
+			for (uint8_t i = 0; i < sim.numStations; i++)
+				printf("  id %u %5.1f%%", sim.config[i].id,
+					sim.stats[i].sent ? sim.stats[i].received * 100.0 / sim.stats[i].sent : 0.0);
+			printf("\n");
+			nextReport += dayNs;
+			}
+		}
+	double secs = (double) (clock() - wall) / CLOCKS_PER_SEC;
+
+	uint32_t sent = 0, received = 0;
+	printf("\nstation     sent  air-lost     heard  received    rx%%   lead   late  rx-on/pkt  yielded  offset\n");
+	for (uint8_t i = 0; i < sim.numStations; i++) {
+		const IssStats &s = sim.stats[i];
+		const Station &st = radio.stations[i];
+		printf("%7u %8u %9u %9u %9u %5.1f%% %6u %6u %8.2fms %8u %5dHz\n", sim.config[i].id, s.sent, s.airLost, s.heard,
+			s.received, s.sent ? s.received * 100.0 / s.sent : 0.0, st.tuneLead, st.lateThresh,
+			st.packets ? st.rxOnTime / 1000.0 / st.packets : 0.0, (unsigned) st.sacrificed,
+			(int) (st.freqOffset * 61.035));
+		sent += s.sent;
+		received += s.received;
+		}
+	printf("  total %8u %29u %5.1f%%\n", sent, received, sent ? received * 100.0 / sent : 0.0);
+	printf("time to sync  count    min s   mean s median s    p90 s    max s\n");
+	printSyncTimes("cold start", coldSync);
+	printSyncTimes("after loss", lostSync);
+	printDriver("driver", radio, model);
+	if (dual) {
+		printDriver("second", radio2, model2);
+		uint32_t heard2 = 0;
+		for (uint8_t i = 0; i < sim.numStations; i++) heard2 += sim.stats[i].heardSecond;
+		printf("diversity: packets %u, duplicates %u, second only %u, heard by second %u, dropped queue %u\n",
+			(unsigned) dual->packets, (unsigned) dual->duplicates, (unsigned) dual->secondOnly,
+			(unsigned) heard2, (unsigned) dual->packetFifo.dropped);
+		}
+	printf("serial bytes %llu, records %llu: %.1f per packet, blocking %.0f us\n", (unsigned long long) board.serialBytes,
+		(unsigned long long) recordBytes, received ? (double) recordBytes / received : 0.0,
+		received ? recordBytes * (double) board.serialByteNs / received / 1000 : 0.0);
+	if (batch) printf("batches: latency mean %.1f s, max %.1f s\n", latencyPackets ? latencySum / latencyPackets : 0.0,
+		latencyMaxMs / 1000.0);
+	static const char *spiOps[SPI_OP_COUNT] = { "hop", "rx", "other" };
+	printf("spi op       calls  transactions       bytes  txn/call  bytes/call\n");
+	for (uint8_t op = 0; op < SPI_OP_COUNT; op++) {
+		const volatile SpiStats &st = radio.spiStats[op];
+		printf("%-8s %9u %13u %11u", spiOps[op], (unsigned) st.calls, (unsigned) st.transactions, (unsigned) st.bytes);
+		if (st.calls) printf(" %9.2f %11.2f", (double) st.transactions / st.calls, (double) st.bytes / st.calls);
+		printf("\n");
+		}
+#ifdef DAVISRFM69_ISR_STATS
+	static const char *isrNames[ISR_COUNT] = { "dio0", "dma" };
+	printf("isr          count  max us  histogram (<2 <4 <8 ... us)\n");
+	for (uint8_t n = 0; n < ISR_COUNT; n++) {
+		const volatile IsrStats &st = radio.isrStats[n];
+		if (st.count == 0) continue;
+		printf("%-8s %9u %7u ", isrNames[n], (unsigned) st.count, (unsigned) st.maxUs);
+		uint8_t last = ISR_HIST_BUCKETS;
+		while (last > 0 && st.hist[last - 1] == 0) last--;
+		for (uint8_t b = 0; b < last; b++) printf(" %u", (unsigned) st.hist[b]);
+		printf("\n");
+		}
+#endif
+	printf("loop() calls %llu\n", (unsigned long long) loops);
+	printf("simulated %.2f days in %.2f s wall (%.0fx real time)\n", days, secs, secs > 0 ? days * 86400 / secs : 0.0);
+	return 0;
+	}
@@ -0,0 +1,137 @@
+// Turns the "t:" trace lines in a DavisRFM69 serial log (DAVISRFM69_DEBUG) back into text.
+// Other lines are passed through unchanged, so packet output stays in context.
+//
+// usage: trace_decode [-q] [file]...
+//   -q     only print trace events
+//
+// e.g. host/build/iss_sim --days 0.01 -v | host/build/trace_decode
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DavisRFM69_trace.h"
+
+static bool quiet;
+
+static const char *modeName(unsigned mode) {
+	static const char *names[] = { "sleep", "standby", "rx", "tx" };
+	if (mode < 4) return names[mode];
+	return mode == 0xff ? "init" : "?";
+	}
+
+static bool parseHex(const char *s, int digits, uint32_t *v) {
+	*v = 0;
+	for (int i = 0; i < digits; i++) {
+		char c = s[i];
+		uint32_t d;
+		if (c >= '0' && c <= '9') d = c - '0';
+		else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+		else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+		else return false;
+		*v = (*v << 4) | d;
+		}
+	return true;
+	}
+
+static bool parseRecord(const char *s, TraceRecord *r) {
+	uint32_t ev, a, b;
+	if (!parseHex(s, 8, &r->time) || !parseHex(s + 8, 2, &ev) || !parseHex(s + 10, 2, &a)
+		|| !parseHex(s + 12, 4, &b) || !parseHex(s + 16, 8, &r->c)) return false;
+	r->event = ev;
+	r->a = a;
+	r->b = b;
+	return true;
+	}
+
+static void printRecord(const TraceRecord &r) {
+	// the argument words hold signed values where the driver stored a difftime()
+	int32_t sc = (int32_t) r.c;
+	printf("%10.6f  ", r.time / 1e6);
+	switch (r.event) {
+			case TR_MISSED:
+				printf("missed packet from station %u channel %u\n", r.a, r.b);
+				break;
+			case TR_LOST:
+				printf("station %u is lost\n", r.a);
+				break;
+			case TR_TUNE_CHECK:
+				printf("station %u channel %u due in %d us\n", r.a, r.b, sc);
+				break;
+			case TR_TUNE:
+				printf("tune to station %u channel %u, due in %d us\n", r.a, r.b, sc);
+				break;
+			case TR_SYNC:
+				printf("begin sync to station %u channel %u, dwell %u us\n", r.a, r.b, r.c);
+				break;
+			case TR_SYNC_FAIL:
+				printf("sync fail, begin sync to station %u channel %u, dwell %u us\n", r.a, r.b, r.c);
+				break;
+			case TR_PROGRESS:
+				printf("listen progress %u%%, free memory %d\n", r.a, sc);
+				break;
+			case TR_SLEEP:
+				printf("nothing to do, going to sleep\n");
+				break;
+			case TR_FOUND:
+				printf("found station %u interval %u\n", r.a, r.c);
+				break;
+			case TR_EARLY:
+				printf("station %u early amt = %d\n", r.a, sc);
+				break;
+			case TR_CHANNEL:
+				if (sc) printf("channel %u, %+d Hz\n", r.a, (int) (sc * 61.035));
+				else printf("channel %u\n", r.a);
+				break;
+			case TR_MODE:
+				printf("mode %s -> %s\n", modeName(r.a), modeName(r.b));
+				break;
+			case TR_CRC_ERROR:
+				printf("bad crc on channel %u\n", r.a);
+				break;
+			case TR_RAW_DROPPED:
+				printf("packet on channel %u dropped, loop() behind\n", r.a);
+				break;
+			case TR_REACQUIRE:
+				printf("look for lost station %u on channel %u, +-%u us\n", r.a, r.b, r.c);
+				break;
+			case TR_COLLISION:
+				printf("collision, station %u kept, station %u given up on, %d us apart\n", r.a, r.b, sc);
+				break;
+			case TR_OVERFLOW:
+				printf("trace full, %u events lost so far\n", r.c);
+				break;
+			default:
+				printf("event %u a %u b %u c %u\n", r.event, r.a, r.b, r.c);
+				break;
+		}
+	}
+
+static void decode(FILE *in) {
+	char line[512];
+	while (fgets(line, sizeof(line), in)) {
+		TraceRecord r;
+		if (!strncmp(line, "t:", 2) && parseRecord(line + 2, &r)) printRecord(r);
+		else if (!quiet) fputs(line, stdout);
+		}
+	}
+
+int main(int argc, char **argv) {
+	int files = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-q")) {
+			quiet = true;
+			continue;
+			}
+		FILE *f = fopen(argv[i], "r");
+		if (f == NULL) {
+			perror(argv[i]);
+			return 1;
+			}
+		decode(f);
+		fclose(f);
+		files++;
+		}
+	if (files == 0) decode(stdin);
+	return 0;
+	}
@@ -0,0 +1,213 @@
+// Reads receiver serial streams, from a device, a log file or stdin, into a column file
+// (see WxIngest.h), and reports how fast it went.
+//
+// usage: wx_ingest [-o FILE] [--baud N] [INPUT]...
+//        wx_ingest --summary FILE
+//   -o FILE      column file to write (default wx.wxc)
+//   --baud N     line speed when an input is a serial device (default 115200)
+//   --summary    list the tables of a column file, their rows and time span
+//
+// Regular files are mapped and tokenized in place; devices and pipes are read in 1 MiB
+// chunks until end of file, or ^C. Rows from a device are stamped with the time they
+// were read, unless the lines carry timestamps themselves.
+//
+// e.g. host/build/wx_ingest -o site1.wxc site1-*.log
+//      host/build/wx_ingest -o live.wxc /dev/ttyACM0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "WxIngest.h"
+
+static volatile sig_atomic_t stop;
+
+static void onSignal(int) { stop = 1; }
+
+static double nowSecs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+static speed_t baudOf(int baud) {
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return B115200;
+		}
+	}
+
+	// raw 8N1, blocking reads
+static bool setupSerial(int fd, int baud) {
+	struct termios tio;
+	if (tcgetattr(fd, &tio) < 0) return false;
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, baudOf(baud));
+	cfsetospeed(&tio, baudOf(baud));
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	return tcsetattr(fd, TCSANOW, &tio) == 0;
+	}
+
+static bool ingest(WxIngest &ing, const char *path, int baud) {
+	int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : 0;
+	if (fd < 0) {
+		perror(path);
+		return false;
+		}
+	struct stat st;
+	fstat(fd, &st);
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			ing.feed((const uint8_t *) map, st.st_size);
+			munmap(map, st.st_size);
+			if (fd) close(fd);
+			return true;
+			}
+		}
+	ing.liveTime = S_ISCHR(st.st_mode);
+	if (isatty(fd) && !setupSerial(fd, baud)) perror(path);
+	static uint8_t buf[1 << 20];
+	while (!stop) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		ing.feed(buf, n);
+		}
+	ing.liveTime = false;
+	if (fd) close(fd);
+	return true;
+	}
+
+static int typeWidth(const char *type) {
+	if (!strcmp(type, "i64")) return 8;
+	if (!strcmp(type, "u32") || !strcmp(type, "f32")) return 4;
+	if (!strcmp(type, "u16") || !strcmp(type, "i16")) return 2;
+	if (!strcmp(type, "u8")) return 1;
+	if (!strncmp(type, "u8x", 3)) return atoi(type + 3);
+	return -1;
+	}
+
+	// List the tables of a column file; the first column is taken to be the i64 time
+static int summary(const char *path) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		perror(path);
+		return 1;
+		}
+	char line[256];
+	if (!fgets(line, sizeof(line), f) || strcmp(line, "WXCOL1\n")) {
+		fprintf(stderr, "%s: not a column file\n", path);
+		return 1;
+		}
+	struct Table {
+		char name[32];
+		int rowBytes;
+		uint64_t rows;
+		int64_t first, last;
+		} tables[256];
+	memset(tables, 0, sizeof(tables));
+	while (fgets(line, sizeof(line), f) && line[0] != '\n') {
+		unsigned id, cols;
+		char name[32];
+		if (sscanf(line, "table %u %31s %u", &id, name, &cols) != 3 || id > 255) return 1;
+		strcpy(tables[id].name, name);
+		for (unsigned c = 0; c < cols && fgets(line, sizeof(line), f); c++) {
+			char col[64], type[16];
+			if (sscanf(line, "%63s %15s", col, type) != 2 || typeWidth(type) < 0) return 1;
+			tables[id].rowBytes += typeWidth(type);
+			}
+		}
+	uint8_t head[5];
+	while (fread(head, 1, sizeof(head), f) == sizeof(head)) {
+		Table &t = tables[head[0]];
+		uint32_t rows = head[1] | head[2] << 8 | head[3] << 16 | (uint32_t) head[4] << 24;
+		if (t.rowBytes == 0 || rows == 0) break;
+		int64_t first, last;
+		long at = ftell(f);
+		if (fread(&first, 8, 1, f) != 1) break;
+		fseek(f, at + (long) (rows - 1) * 8, SEEK_SET);
+		if (fread(&last, 8, 1, f) != 1) break;
+		if (t.rows == 0) t.first = first;
+		t.last = last;
+		t.rows += rows;
+		fseek(f, at + (long) rows * t.rowBytes, SEEK_SET);
+		}
+	printf("table          rows   first time ms    last time ms\n");
+	for (int id = 0; id < 256; id++)
+		if (tables[id].name[0]) printf("%-8s %10llu %15lld %15lld\n", tables[id].name, (unsigned long long) tables[id].rows,
+			(long long) tables[id].first, (long long) tables[id].last);
+	fclose(f);
+	return 0;
+	}
+
+static void usage() {
+	fprintf(stderr, "usage: wx_ingest [-o FILE] [--baud N] [INPUT]...\n"
+		"       wx_ingest --summary FILE\n");
+	exit(2);
+	}
+
+int main(int argc, char **argv) {
+	const char *outPath = "wx.wxc";
+	int baud = 115200;
+	const char *inputs[256];
+	int nInputs = 0;
+	for (int a = 1; a < argc; a++) {
+		const char *val = a + 1 < argc ? argv[a + 1] : NULL;
+		if (!strcmp(argv[a], "--summary")) {
+			if (!val) usage();
+			return summary(val);
+			}
+		else if (!strcmp(argv[a], "-o")) { if (!val) usage(); outPath = val; a++; }
+		else if (!strcmp(argv[a], "--baud")) { if (!val) usage(); baud = atoi(val); a++; }
+		else if (argv[a][0] == '-' && argv[a][1]) usage();
+		else if (nInputs < 256) inputs[nInputs++] = argv[a];
+		}
+	if (nInputs == 0) inputs[nInputs++] = "-";
+
+	FILE *out = fopen(outPath, "wb");
+	if (out == NULL) {
+		perror(outPath);
+		return 1;
+		}
+	static char outBuf[1 << 20];
+	setvbuf(out, outBuf, _IOFBF, sizeof(outBuf));
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	WxIngest ing(out);
+	double t0 = nowSecs();
+	bool ok = true;
+	for (int i = 0; i < nInputs && !stop; i++) ok &= ingest(ing, inputs[i], baud);
+	ing.finish();
+	double secs = nowSecs() - t0;
+	fclose(out);
+
+	const IngestStats &s = ing.stats;
+	fprintf(stderr, "%llu bytes, %llu lines, %llu records (%llu deltas, %llu before a keyframe), %llu summaries: "
+		"c: %llu, bme: %llu, raw: %llu, t: %llu, other %llu, bad %llu\n",
+		(unsigned long long) s.bytes, (unsigned long long) s.lines, (unsigned long long) s.frames,
+		(unsigned long long) ing.deltas(), (unsigned long long) s.unkeyed, (unsigned long long) s.summaries,
+		(unsigned long long) s.csv, (unsigned long long) s.bme, (unsigned long long) s.raw,
+		(unsigned long long) s.trace, (unsigned long long) s.other, (unsigned long long) s.bad);
+	fprintf(stderr, "%.3f s, %.0f lines/s, %.0f records/s, %.1f MB/s\n", secs, secs > 0 ? s.lines / secs : 0.0,
+		secs > 0 ? s.frames / secs : 0.0, secs > 0 ? s.bytes / secs / 1e6 : 0.0);
+	return ok ? 0 : 1;
+	}